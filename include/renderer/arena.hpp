@@ -0,0 +1,70 @@
+#pragma once
+// 帧内临时内存：线性（bump）分配器，每帧开头 reset 一次，之后分配只移动指针。
+// 内存块跨帧保留；某帧用量超出时追加新块，下次 reset 把所有块合并成一块，此后每帧不再触碰堆
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+#include <type_traits>
+
+static const size_t kArenaAlign = 64; // 默认按缓存行对齐，分块并行写入时互不共享缓存行
+
+class FrameArena {
+public:
+    explicit FrameArena(size_t initialBytes = size_t(1) << 20) : initial_(initialBytes) {}
+    ~FrameArena() { release(); }
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // align 须为 2 的幂；内存在下次 reset 前有效。非线程安全：每个线程各用一个实例
+    void* alloc(size_t bytes, size_t align = kArenaAlign) {
+        if (!blocks_.empty()) {
+            Block& b = blocks_.back();
+            std::uintptr_t base = (std::uintptr_t)b.data, p = (base + used_ + align - 1) & ~(std::uintptr_t)(align - 1);
+            if (p + bytes <= base + b.size) { used_ = (size_t)(p + bytes - base); total_ += bytes; return (void*)p; }
+        }
+        size_t want = bytes + align;
+        if (!blocks_.empty()) want = std::max(want, blocks_.back().size * 2);
+        addBlock(std::max(want, initial_));
+        return alloc(bytes, align);
+    }
+
+    // 只用于平凡析构的类型：不调用构造/析构，调用方负责写满
+    template<typename T>
+    T* allocArray(size_t n) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena memory is never destroyed");
+        return static_cast<T*>(alloc(n * sizeof(T), alignof(T) > kArenaAlign ? alignof(T) : kArenaAlign));
+    }
+
+    // 帧开头调用：之前分配的内存全部失效
+    void reset() {
+        if (blocks_.size() > 1) { // 上一帧溢出过：合并成一块，容量为各块之和
+            size_t cap = capacity();
+            release();
+            addBlock(cap);
+        }
+        used_ = 0; total_ = 0;
+    }
+
+    size_t used() const { return total_; }  // 本帧已分配字节数（不含对齐填充）
+    size_t capacity() const { size_t c = 0; for (const Block& b : blocks_) c += b.size; return c; }
+    std::uint64_t blockAllocs() const { return blockAllocs_; } // 累计向堆申请块的次数
+
+private:
+    struct Block { char* data; size_t size; };
+
+    void addBlock(size_t size) {
+        blocks_.push_back(Block{ static_cast<char*>(::operator new(size)), size });
+        used_ = 0; ++blockAllocs_;
+    }
+    void release() {
+        for (Block& b : blocks_) ::operator delete(b.data);
+        blocks_.clear();
+    }
+
+    std::vector<Block> blocks_;
+    size_t initial_;
+    size_t used_ = 0, total_ = 0; // used_：末块内偏移
+    std::uint64_t blockAllocs_ = 0;
+};
@@ -0,0 +1,126 @@
+#pragma once
+// 排序中置（sort-middle）分块：裁剪后的三角形按屏幕 tile 分桶，再按 tile 并行光栅化
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "pipeline.hpp"
+#include "common.hpp"
+
+static const int kTileSize = 64;
+static const int kBinChunkTris = 4096; // 每个分桶任务负责的三角形数
+// 帧内三角形编号 = (chunk << kBinTriBits) | chunk 内下标；裁剪最多把一个三角形拆成 kMaxClipVerts - 2 个
+static const int kBinTriBits = 15;
+static_assert((kMaxClipVerts - 2) * kBinChunkTris <= (1 << kBinTriBits), "kBinTriBits too small");
+
+// 一个 chunk = 某次绘制中连续的一段三角形。
+// tile 内按 chunk 顺序、chunk 内按三角形顺序绘制，与串行逐个提交的顺序一致，结果逐位相同。
+template<typename V>
+struct BinChunk {
+    const V* verts = nullptr;
+    const glm::ivec3* idx = nullptr;
+    int first = 0, last = 0;   // 负责 idx[first, last)
+    int draw = 0;              // 所属绘制编号（由调用方解释，如选择纹理）
+    std::vector<V> clipVerts;                     // 裁剪新生成的顶点
+    std::vector<glm::ivec3> tris;                 // 顶点下标；<0 表示 clipVerts[~i]
+    std::vector<std::vector<std::uint32_t>> bins; // 每个 tile 覆盖到的 tris 下标（升序）
+    const V& vert(int i) const { return i >= 0 ? verts[i] : clipVerts[~i]; }
+};
+
+template<typename V>
+struct TileBins {
+    int w = 0, h = 0, tileSize = kTileSize, tilesX = 0, tilesY = 0;
+    int chunkCount = 0;
+    int coverPad = 0;                // 覆盖测试点离像素中心的最大偏移（1/16 像素）；MSAA 时为采样点范围，0 为像素中心
+    std::vector<BinChunk<V>> chunks; // 跨帧复用，只增不减
+
+    void resize(int W, int H, int ts = kTileSize) {
+        w = W; h = H; tileSize = ts;
+        tilesX = (W + ts - 1) / ts; tilesY = (H + ts - 1) / ts;
+        chunks.clear(); chunkCount = 0;
+    }
+    int tileCount() const { return tilesX * tilesY; }
+    RectI tileRect(int t) const {
+        int tx = t % tilesX, ty = t / tilesX;
+        return RectI{ tx * tileSize, ty * tileSize, std::min(w, (tx + 1) * tileSize) - 1, std::min(h, (ty + 1) * tileSize) - 1 };
+    }
+
+    void beginFrame() { chunkCount = 0; }
+
+    // 由帧内三角形编号取回所属 chunk 与顶点
+    const BinChunk<V>& chunkOf(std::uint32_t id) const { return chunks[id >> kBinTriBits]; }
+    const glm::ivec3& triangle(std::uint32_t id) const { return chunkOf(id).tris[id & ((1u << kBinTriBits) - 1)]; }
+
+    // 登记一次绘制，按 kBinChunkTris 切成若干 chunk（单线程调用，须在分桶前完成）
+    void addDraw(const V* verts, const glm::ivec3* idx, size_t triCount, int draw) {
+        for (size_t first = 0; first < triCount; first += kBinChunkTris) {
+            if ((int)chunks.size() <= chunkCount) chunks.emplace_back();
+            BinChunk<V>& c = chunks[chunkCount++];
+            c.verts = verts; c.idx = idx; c.draw = draw;
+            c.first = (int)first; c.last = (int)std::min(triCount, first + kBinChunkTris);
+            c.clipVerts.clear(); c.tris.clear();
+            c.bins.resize(tileCount());
+            for (auto& b : c.bins) b.clear();
+        }
+    }
+};
+
+// 裁剪 + 剔除 + 分桶一个 chunk；不同 chunk 可并行。accept(a, b, c) 为三角形级剔除
+template<typename V, typename Accept>
+static inline void binChunk(TileBins<V>& tb, int chunk, Accept accept) {
+    BinChunk<V>& c = tb.chunks[chunk];
+    auto emit = [&](int i0, int i1, int i2) {
+        const V& a = c.vert(i0); const V& b = c.vert(i1); const V& d = c.vert(i2);
+        if (!accept(a, b, d)) return;
+        const int pad = tb.coverPad;
+        int minX = std::max(0, fxFirstPixel(std::min(a.screen.x, std::min(b.screen.x, d.screen.x)) - pad));
+        int maxX = std::min(tb.w - 1, fxLastPixel(std::max(a.screen.x, std::max(b.screen.x, d.screen.x)) + pad));
+        int minY = std::max(0, fxFirstPixel(std::min(a.screen.y, std::min(b.screen.y, d.screen.y)) - pad));
+        int maxY = std::min(tb.h - 1, fxLastPixel(std::max(a.screen.y, std::max(b.screen.y, d.screen.y)) + pad));
+        if (minX > maxX || minY > maxY) return;
+        // 小三角形在分桶前就测试像素中心：一个都不覆盖（细长或亚像素三角形常见）则丢弃
+        if (pad == 0 && (maxX - minX + 1) * (maxY - minY + 1) <= kSmallTriPixels) {
+            glm::ivec2 p0 = a.screen, p1 = b.screen, p2 = d.screen;
+            std::int64_t area = edgeFunctionFx(p0, p1, p2);
+            if (area == 0) return;
+            if (area < 0) std::swap(p1, p2);
+            EdgeFx e[3] = { setupEdgeFx(p1, p2, minX, minY), setupEdgeFx(p2, p0, minX, minY), setupEdgeFx(p0, p1, minX, minY) };
+            if (!coverageMaskSmall(e, minX, minY, maxX, maxY)) return;
+        }
+        std::uint32_t id = (std::uint32_t)c.tris.size(); c.tris.push_back(glm::ivec3(i0, i1, i2));
+        for (int ty = minY / tb.tileSize; ty <= maxY / tb.tileSize; ++ty)
+            for (int tx = minX / tb.tileSize; tx <= maxX / tb.tileSize; ++tx)
+                c.bins[ty * tb.tilesX + tx].push_back(id);
+        };
+    for (int t = c.first; t < c.last; ++t) {
+        const glm::ivec3& tri = c.idx[t];
+        const V& A = c.verts[tri.x]; const V& B = c.verts[tri.y]; const V& C = c.verts[tri.z];
+        if (frustumOutcode(A.clip) & frustumOutcode(B.clip) & frustumOutcode(C.clip)) continue; // 整体在视锥某个平面之外
+        // 三点都在近平面与保护带内侧时直接引用原顶点，视口外的部分由包围盒裁掉
+        unsigned mask = clipPlaneMask(A.clip) | clipPlaneMask(B.clip) | clipPlaneMask(C.clip);
+        if (!mask) { emit(tri.x, tri.y, tri.z); continue; }
+        V poly[kMaxClipVerts];
+        int nv = clipTriangleGuardBand(A, B, C, mask, poly, tb.w, tb.h);
+        if (nv < 3) continue;
+        int base = (int)c.clipVerts.size();
+        for (int k = 0; k < nv; ++k) c.clipVerts.push_back(poly[k]);
+        for (int k = 1; k + 1 < nv; ++k) emit(~base, ~(base + k), ~(base + k + 1));
+    }
+}
+
+// 按确定顺序遍历落在 tile 内的三角形：f(triId, chunk, v0, v1, v2)，triId 为帧内三角形编号
+template<typename V, typename F>
+static inline void forEachBinnedTriangleId(const TileBins<V>& tb, int tile, F f) {
+    for (int ci = 0; ci < tb.chunkCount; ++ci) {
+        const BinChunk<V>& c = tb.chunks[ci];
+        for (std::uint32_t id : c.bins[tile]) {
+            const glm::ivec3& t = c.tris[id];
+            f(((std::uint32_t)ci << kBinTriBits) | id, c, c.vert(t.x), c.vert(t.y), c.vert(t.z));
+        }
+    }
+}
+
+// 同上，不需要编号：f(chunk, v0, v1, v2)
+template<typename V, typename F>
+static inline void forEachBinnedTriangle(const TileBins<V>& tb, int tile, F f) {
+    forEachBinnedTriangleId(tb, tile, [&](std::uint32_t, const BinChunk<V>& c, const V& a, const V& b, const V& d) { f(c, a, b, d); });
+}
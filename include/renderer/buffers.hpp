@@ -1,7 +1,9 @@
 #pragma once
-// ֡Ȼ
+// 帧缓冲与深度缓冲
 #include <vector>
 #include <cstdint>
+#include <algorithm>
+#include "common.hpp"
 
 
 struct Framebuffer {
@@ -9,6 +11,9 @@ struct Framebuffer {
 	std::vector<std::uint32_t> pixels;
 	Framebuffer(int W, int H) : w(W), h(H), pixels(W* H, 0xff000000u) {}
 	void clear(std::uint32_t argb) { std::fill(pixels.begin(), pixels.end(), argb); }
+	void clear(std::uint32_t argb, const RectI& r) {
+		for (int y = r.y0; y <= r.y1; ++y) std::fill(&pixels[y * w + r.x0], &pixels[y * w + r.x1] + 1, argb);
+	}
 	inline void putPixel(int x, int y, std::uint32_t argb) {
 		if ((unsigned)x >= (unsigned)w || (unsigned)y >= (unsigned)h) return;
 		pixels[y * w + x] = argb;
@@ -16,10 +21,57 @@ struct Framebuffer {
 };
 
 
+// 分层深度（HiZ）块大小
+static const int kHiZBlock = 8;
+
+// 深度缓冲 + 每个 8x8 块的保守深度范围 [zMin, zMax]。
+// 深度只会被写小，因此 zMax 始终是块内深度的上界；块被写过后 dirty = 1，此时 zMin 失效，需要时再重算。
+// 直接改写 z 的代码须调用 markDirty / clear 以保持一致。
 struct DepthBuffer {
 	int w, h;
 	std::vector<float> z;
-	DepthBuffer(int W, int H) : w(W), h(H), z(W* H, 1.0f) {}
-	void clear(float v = 1.0f) { std::fill(z.begin(), z.end(), v); }
+	int bw, bh;
+	std::vector<float> zMin, zMax;
+	std::vector<std::uint8_t> dirty;
+	DepthBuffer(int W, int H) : w(W), h(H), z(W* H, 1.0f),
+		bw((W + kHiZBlock - 1) / kHiZBlock), bh((H + kHiZBlock - 1) / kHiZBlock),
+		zMin(bw* bh, 1.0f), zMax(bw* bh, 1.0f), dirty(bw* bh, 0) {}
+	void clear(float v = 1.0f) {
+		std::fill(z.begin(), z.end(), v);
+		std::fill(zMin.begin(), zMin.end(), v); std::fill(zMax.begin(), zMax.end(), v); std::fill(dirty.begin(), dirty.end(), 0);
+	}
+	void clear(float v, const RectI& r) {
+		for (int y = r.y0; y <= r.y1; ++y) std::fill(&z[y * w + r.x0], &z[y * w + r.x1] + 1, v);
+		for (int by = r.y0 / kHiZBlock; by <= r.y1 / kHiZBlock; ++by) {
+			for (int bx = r.x0 / kHiZBlock; bx <= r.x1 / kHiZBlock; ++bx) {
+				int b = by * bw + bx;
+				int x0 = bx * kHiZBlock, y0 = by * kHiZBlock;
+				int x1 = std::min(w, x0 + kHiZBlock) - 1, y1 = std::min(h, y0 + kHiZBlock) - 1;
+				if (x0 >= r.x0 && x1 <= r.x1 && y0 >= r.y0 && y1 <= r.y1) { zMin[b] = zMax[b] = v; dirty[b] = 0; }
+				else { zMin[b] = std::min(zMin[b], v); zMax[b] = std::max(zMax[b], v); } // 部分清除：放宽范围
+			}
+		}
+	}
 	inline float& at(int x, int y) { return z[y * w + x]; }
+
+	void markDirty(int bx, int by) { dirty[by * bw + bx] = 1; }
+	// 扫描块内像素重算精确范围
+	void refreshBlock(int bx, int by) {
+		int b = by * bw + bx;
+		int x0 = bx * kHiZBlock, y0 = by * kHiZBlock;
+		int x1 = std::min(w, x0 + kHiZBlock), y1 = std::min(h, y0 + kHiZBlock);
+		float mn = z[y0 * w + x0], mx = mn;
+		for (int y = y0; y < y1; ++y)
+			for (int x = x0; x < x1; ++x) { float v = z[y * w + x]; mn = std::min(mn, v); mx = std::max(mx, v); }
+		zMin[b] = mn; zMax[b] = mx; dirty[b] = 0;
+	}
+	// 深度不小于 zTest 的片元在该块内是否必然全部失败（z < zref 才通过）
+	// refresh = false 时只用现有上界判断（小三角形重算范围得不偿失）
+	bool blockOccludes(int bx, int by, float zTest, bool refresh = true) {
+		int b = by * bw + bx;
+		if (zTest >= zMax[b]) return true;
+		if (!dirty[b] || !refresh) return false;
+		refreshBlock(bx, by);
+		return zTest >= zMax[b];
+	}
 };
\ No newline at end of file
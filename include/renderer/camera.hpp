@@ -1,5 +1,5 @@
 #pragma once
-//  + ZO ȣ
+// 简单相机（右手 + ZO 深度）
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
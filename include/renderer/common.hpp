@@ -1,5 +1,5 @@
 #pragma once
-// ͨС
+// 通用小工具
 #include <cstdint>
 #include <algorithm>
 #include <glm/glm.hpp>
@@ -20,6 +20,60 @@ static inline float edgeFunction(const glm::vec2& a, const glm::vec2& b, const g
 }
 
 
+// 屏幕坐标使用 28.4 定点（1/16 像素精度）
+static const int kSubPixelBits = 4;
+static const int kSubPixelScale = 1 << kSubPixelBits;
+static const int kSubPixelHalf = kSubPixelScale / 2;
+
+// 定点边函数 E(p) = (p.x - a.x) * (b.y - a.y) - (p.y - a.y) * (b.x - a.x)，沿行/列增量步进。
+// row 已计入左上填充规则的偏置（非左上边 -1），覆盖测试只需 >= 0；求重心坐标时减回 bias。
+struct EdgeFx {
+	std::int64_t row, stepX, stepY, bias;
+};
+
+// 三角形正面积（a→b→c 使 E>0 在内侧）时：左边 dy>0，上边 dy==0 && dx<0
+static inline EdgeFx setupEdgeFx(const glm::ivec2& a, const glm::ivec2& b, int x0, int y0) {
+	std::int64_t dx = (std::int64_t)b.x - a.x, dy = (std::int64_t)b.y - a.y;
+	std::int64_t px = ((std::int64_t)x0 << kSubPixelBits) + kSubPixelHalf; // 像素中心
+	std::int64_t py = ((std::int64_t)y0 << kSubPixelBits) + kSubPixelHalf;
+	bool topLeft = (dy > 0) || (dy == 0 && dx < 0);
+	EdgeFx e;
+	e.bias = topLeft ? 0 : -1;
+	e.row = (px - a.x) * dy - (py - a.y) * dx + e.bias;
+	e.stepX = dy * kSubPixelScale; e.stepY = -dx * kSubPixelScale;
+	return e;
+}
+
+static inline std::int64_t edgeFunctionFx(const glm::ivec2& a, const glm::ivec2& b, const glm::ivec2& p) {
+	return ((std::int64_t)p.x - a.x) * ((std::int64_t)b.y - a.y) - ((std::int64_t)p.y - a.y) * ((std::int64_t)b.x - a.x);
+}
+
+// 包围盒不超过此像素数的三角形走小三角形路径：直接测试每个像素中心（掩码须放得下）
+static const int kSmallTriPixels = 16;
+static_assert(kSmallTriPixels < 32, "coverage mask is 32 bits");
+
+// 包围盒 [minX, maxX] x [minY, maxY] 内被覆盖的像素中心，包围盒内行优先置位；e 以 (minX, minY) 为起点
+static inline std::uint32_t coverageMaskSmall(const EdgeFx* e, int minX, int minY, int maxX, int maxY) {
+	std::uint32_t m = 0; int bit = 0;
+	for (int y = minY; y <= maxY; ++y) {
+		std::int64_t E0 = e[0].row + (y - minY) * e[0].stepY, E1 = e[1].row + (y - minY) * e[1].stepY, E2 = e[2].row + (y - minY) * e[2].stepY;
+		for (int x = minX; x <= maxX; ++x, ++bit, E0 += e[0].stepX, E1 += e[1].stepX, E2 += e[2].stepX)
+			if ((E0 | E1 | E2) >= 0) m |= 1u << bit;
+	}
+	return m;
+}
+
+// 定点坐标范围 [lo, hi] 内的像素中心下标范围（可能为空）
+static inline int fxFirstPixel(int lo) { return (lo - kSubPixelHalf + kSubPixelScale - 1) >> kSubPixelBits; }
+static inline int fxLastPixel(int hi) { return (hi - kSubPixelHalf) >> kSubPixelBits; }
+
+
+// 闭区间像素矩形（分块光栅化的裁剪区域）
+struct RectI {
+	int x0, y0, x1, y1;
+};
+
+
 template <typename T>
 static inline const T& clampT(const T& v, const T& lo, const T& hi) {
 	return (v < lo) ? lo : (hi < v) ? hi : v;
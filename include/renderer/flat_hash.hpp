@@ -0,0 +1,65 @@
+#pragma once
+// 开放寻址哈希表（线性探测，容量为 2 的幂，装载率不超过 1/2）：键 -> 非负 int，只插入不删除。
+// 键与值各一条连续数组，没有逐元素的节点分配；用于加载期的顶点去重
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// 64 位整数混合（splitmix64 的收尾），哈希分布均匀，线性探测才不会聚堆
+static inline std::uint64_t mixHash64(std::uint64_t h) {
+    h ^= h >> 30; h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27; h *= 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+// H 为返回 std::uint64_t 的哈希函数对象，K 须可 == 比较
+template<typename K, typename H>
+class FlatIndexMap {
+public:
+    explicit FlatIndexMap(size_t expected = 0) { reserve(expected); }
+
+    // 预留至少能放下 n 个键的容量（之后不再扩容）
+    void reserve(size_t n) {
+        size_t cap = 16;
+        while (cap < n * 2) cap <<= 1;
+        if (cap > vals_.size()) rehash(cap);
+    }
+    // 查找 k：存在则返回已有的值，否则插入 (k, v) 并返回 v
+    int findOrInsert(const K& k, int v) {
+        if ((size_ + 1) * 2 > vals_.size()) rehash(vals_.size() * 2);
+        size_t mask = vals_.size() - 1, i = (size_t)H()(k) & mask;
+        while (vals_[i] >= 0) {
+            if (keys_[i] == k) return vals_[i];
+            i = (i + 1) & mask;
+        }
+        keys_[i] = k; vals_[i] = v; ++size_;
+        return v;
+    }
+    // 不存在返回 -1
+    int find(const K& k) const {
+        size_t mask = vals_.size() - 1, i = (size_t)H()(k) & mask;
+        while (vals_[i] >= 0) {
+            if (keys_[i] == k) return vals_[i];
+            i = (i + 1) & mask;
+        }
+        return -1;
+    }
+    size_t size() const { return size_; }
+    void clear() { vals_.assign(vals_.size(), -1); size_ = 0; }
+
+private:
+    void rehash(size_t cap) {
+        std::vector<K> keys(cap); std::vector<int> vals(cap, -1);
+        for (size_t j = 0; j < vals_.size(); ++j) {
+            if (vals_[j] < 0) continue;
+            size_t i = (size_t)H()(keys_[j]) & (cap - 1);
+            while (vals[i] >= 0) i = (i + 1) & (cap - 1);
+            keys[i] = keys_[j]; vals[i] = vals_[j];
+        }
+        keys_.swap(keys); vals_.swap(vals);
+    }
+
+    std::vector<K> keys_;
+    std::vector<int> vals_; // -1 表示空位
+    size_t size_ = 0;
+};
@@ -1,5 +1,5 @@
 #pragma once
-// Windows 루GetAsyncKeyState _WIN32 Ч
+// Windows 键盘输入（GetAsyncKeyState），仅在 _WIN32 下有效
 #ifdef _WIN32
 #define NOMINMAX
 #include <windows.h>
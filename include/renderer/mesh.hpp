@@ -1,5 +1,8 @@
 #pragma once
-// 
+// 顶点输入
+#include <vector>
+#include <cstddef>
+#include <utility>
 #include <glm/glm.hpp>
 
 
@@ -8,4 +11,62 @@ struct VertexIn {
 	glm::vec3 color;
 	glm::vec2 uv;
 	glm::vec3 normal;
+};
+
+
+// 网格数据的连续数组：自有存储（std::vector），或借用外部的只读内存（映射的网格缓存，见 mesh_cache.hpp）。
+// 读接口同 std::vector；写接口（resize、非 const 下标）只用于自有存储
+template<typename T>
+class MeshArray {
+public:
+	MeshArray() {}
+	MeshArray(std::vector<T>&& v) : own_(std::move(v)) { sync(); }
+	MeshArray(const MeshArray& o) : own_(o.own_) { if (o.borrowed()) borrow(o.ptr_, o.n_); else sync(); }
+	MeshArray(MeshArray&& o) noexcept : own_(std::move(o.own_)), ptr_(o.ptr_), n_(o.n_) { o.ptr_ = nullptr; o.n_ = 0; }
+	MeshArray& operator=(MeshArray o) noexcept { own_.swap(o.own_); std::swap(ptr_, o.ptr_); std::swap(n_, o.n_); return *this; }
+	MeshArray& operator=(std::vector<T>&& v) { own_ = std::move(v); sync(); return *this; }
+
+	// 指向外部内存（须比本数组活得久），释放自有存储
+	void borrow(const T* p, size_t n) { std::vector<T>().swap(own_); ptr_ = p; n_ = n; }
+	bool borrowed() const { return ptr_ != own_.data() || n_ != own_.size(); }
+	// 自有存储（建网格时使用）
+	const std::vector<T>& owned() const { return own_; }
+
+	size_t size() const { return n_; }
+	bool empty() const { return n_ == 0; }
+	const T* data() const { return ptr_; }
+	const T& operator[](size_t i) const { return ptr_[i]; }
+	const T* begin() const { return ptr_; }
+	const T* end() const { return ptr_ + n_; }
+
+	T& operator[](size_t i) { return own_[i]; }
+	void resize(size_t n) { own_.resize(n); sync(); }
+	void clear() { own_.clear(); sync(); }
+
+private:
+	void sync() { ptr_ = own_.data(); n_ = own_.size(); }
+
+	std::vector<T> own_;
+	const T* ptr_ = nullptr;
+	size_t n_ = 0;
+};
+
+
+// 结构数组（SoA）形式的顶点输入：每个分量一条连续数组，批处理顶点阶段一次读 4/8 个顶点
+struct VertexStreams {
+	MeshArray<float> px, py, pz, nx, ny, nz, r, g, b, u, v;
+	VertexStreams() {}
+	explicit VertexStreams(const std::vector<VertexIn>& verts) { assign(verts); }
+	size_t size() const { return px.size(); }
+	void assign(const std::vector<VertexIn>& verts) {
+		MeshArray<float>* s[11] = { &px, &py, &pz, &nx, &ny, &nz, &r, &g, &b, &u, &v };
+		for (auto* a : s) a->resize(verts.size());
+		for (size_t i = 0; i < verts.size(); ++i) {
+			const VertexIn& vi = verts[i];
+			px[i] = vi.pos.x; py[i] = vi.pos.y; pz[i] = vi.pos.z;
+			nx[i] = vi.normal.x; ny[i] = vi.normal.y; nz[i] = vi.normal.z;
+			r[i] = vi.color.r; g[i] = vi.color.g; b[i] = vi.color.b;
+			u[i] = vi.uv.x; v[i] = vi.uv.y;
+		}
+	}
 };
\ No newline at end of file
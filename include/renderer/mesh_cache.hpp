@@ -0,0 +1,253 @@
+#pragma once
+// 网格缓存：Scene::addMesh 建好的整条 LOD 链（各级的 SoA / 压缩顶点流、meshlet 顺序的索引、meshlet 与顶点块、
+// 包围盒、LOD 误差）按渲染时的内存布局写成二进制旁路文件（<模型>.meshcache）。
+// 键为源文件内容哈希 + 加载 / 建网格选项；命中时整个文件只读映射，各数组直接借用映射内存（MeshArray::borrow），
+// 不解析、不补法线、不单位化、不建 meshlet 与 LOD，也不复制。
+// 布局：MeshCacheHeader，levelCount 个 MeshCacheLevel，之后各数组按 kMeshCacheAlign 对齐依次存放（偏移自文件头起算）
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+#include "scene.hpp"
+#include "obj_loader.hpp"
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
+#include "flat_hash.hpp"
+
+static const char kMeshCacheMagic[8] = { 'R', 'M', 'E', 'S', 'H', 'C', 'C', 'H' };
+static const std::uint32_t kMeshCacheVersion = 3;
+static const std::uint32_t kMeshCacheEndianTag = 0x01020304u;
+static const size_t kMeshCacheAlign = 64;
+static const int kMeshCacheStreams = 11;
+static const size_t kMeshCacheHashBlock = 4 << 20; // 源文件按块并行哈希
+
+struct MeshCacheKey {
+    std::uint64_t source = 0;  // 源文件内容
+    std::uint64_t options = 0; // 加载 / 建网格选项与格式版本
+};
+
+struct MeshCacheHeader {
+    char magic[8];
+    std::uint32_t version, levelCount;
+    std::uint64_t sourceHash, optionsHash;
+    std::uint64_t fileBytes;  // 文件总长（检测截断）
+    std::uint32_t layout[4];  // sizeof(Meshlet)、sizeof(glm::ivec3)、sizeof(Tri16)、字节序标记
+};
+
+struct MeshCacheArray { std::uint64_t offset, count; }; // count 为元素数
+
+struct MeshCacheLevel {
+    float boundsMin[3], boundsMax[3];
+    float lodError;
+    std::uint32_t quantized;          // 1：顶点流为 QuantizedStreams
+    float posOffset[3], posScale[3];  // 位置量化参数
+    float color[3];                   // 压缩格式的常量颜色
+    std::uint32_t reserved;
+    std::uint64_t vertexCount;
+    MeshCacheArray streams[kMeshCacheStreams]; // 浮点：px py pz nx ny nz r g b u v；压缩：px py pz ox oy u v rgb
+    MeshCacheArray idx, idx16, meshlets, blocks;
+};
+
+// 非加密的内容哈希：每 32 字节分 4 路 64 位字做乘法混合，尾部逐字节
+static inline std::uint64_t hashBytes(const char* p, size_t n, std::uint64_t seed) {
+    std::uint64_t h[4] = { seed ^ 0x9e3779b97f4a7c15ull, seed ^ 0xc2b2ae3d27d4eb4full, seed ^ 0x165667b19e3779f9ull, seed ^ 0x27d4eb2f165667c5ull };
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+        for (int k = 0; k < 4; ++k) {
+            std::uint64_t w; std::memcpy(&w, p + i + 8 * k, sizeof(w));
+            h[k] = (h[k] ^ w) * 0x9fb21c651e98df25ull; h[k] ^= h[k] >> 29;
+        }
+    std::uint64_t t = n;
+    for (; i < n; ++i) t = (t ^ (std::uint8_t)p[i]) * 0x100000001b3ull;
+    return mixHash64(h[0] ^ mixHash64(h[1] ^ mixHash64(h[2] ^ mixHash64(h[3] ^ t))));
+}
+
+// 源文件内容哈希：按固定大小的块求哈希（pool 非空时并行），再按块顺序合并，结果与线程数无关。打不开返回 false
+static inline bool hashFileContents(const char* path, ThreadPool* pool, std::uint64_t& out) {
+    MappedFile f(path); if (!f.data()) return false;
+    const size_t nb = (f.size() + kMeshCacheHashBlock - 1) / kMeshCacheHashBlock;
+    std::vector<std::uint64_t> block(nb);
+    auto hashBlock = [&](int b, int) {
+        size_t begin = (size_t)b * kMeshCacheHashBlock;
+        block[b] = hashBytes(f.data() + begin, std::min(kMeshCacheHashBlock, f.size() - begin), (std::uint64_t)b);
+    };
+    if (pool) pool->parallelFor((int)nb, hashBlock);
+    else for (size_t b = 0; b < nb; ++b) hashBlock((int)b, 0);
+    std::uint64_t h = mixHash64(f.size());
+    for (std::uint64_t x : block) h = mixHash64(h ^ x);
+    out = h;
+    return true;
+}
+
+// 键：源文件内容 + 影响结果的全部选项（加载选项、LOD 级数、是否压缩、meshlet / 顶点块 / LOD 的构建常量）
+static inline bool makeMeshCacheKey(const char* srcPath, const OBJLoadOptions& opt, int lodLevels, bool quantize, MeshCacheKey& key) {
+    if (!hashFileContents(srcPath, opt.pool, key.source)) return false;
+    std::uint32_t weldBits; std::memcpy(&weldBits, &opt.weldEpsilon, sizeof(weldBits));
+    const std::uint64_t fields[] = { kMeshCacheVersion, (std::uint64_t)opt.normalizeToUnit, (std::uint64_t)opt.flipV, (std::uint64_t)opt.mergeVertices, (std::uint64_t)opt.smoothGeneratedNormals,
+        weldBits, (std::uint64_t)lodLevels, (std::uint64_t)quantize, (std::uint64_t)kMeshletMaxTris, (std::uint64_t)kMeshletMaxVerts,
+        (std::uint64_t)kVertexBlock, (std::uint64_t)kLodMinTris, (std::uint64_t)kIndex16MaxVerts };
+    std::uint64_t h = 0;
+    for (std::uint64_t f : fields) h = mixHash64(h ^ f);
+    key.options = h;
+    return true;
+}
+
+static inline std::string meshCachePath(const char* srcPath) { return std::string(srcPath) + ".meshcache"; }
+
+static inline size_t meshCacheAlignUp(size_t x) { return (x + kMeshCacheAlign - 1) / kMeshCacheAlign * kMeshCacheAlign; }
+
+// 写入：先安排各数组的偏移，再按偏移顺序写出
+struct MeshCacheWriter {
+    struct Blob { const void* data; size_t bytes, offset; };
+    std::vector<Blob> blobs;
+    size_t end = 0;
+
+    template<typename T>
+    void place(MeshCacheArray& a, const MeshArray<T>& arr) {
+        a.offset = end; a.count = arr.size();
+        if (!arr.empty()) blobs.push_back({ arr.data(), arr.size() * sizeof(T), end });
+        end = meshCacheAlignUp(end + arr.size() * sizeof(T));
+    }
+};
+
+// 临时文件名带进程号与进程内序号，同时运行的多个进程 / 线程各写各的
+static inline std::string meshCacheTempPath(const std::string& path) {
+    static std::atomic<unsigned> serial(0);
+#ifdef _WIN32
+    const unsigned long pid = (unsigned long)GetCurrentProcessId();
+#else
+    const unsigned long pid = (unsigned long)getpid();
+#endif
+    return path + "." + std::to_string(pid) + "-" + std::to_string(serial++) + ".tmp";
+}
+
+// 用 from 原子地替换 to（to 已存在时也不先删除，读端只会看到旧文件或新文件）
+static inline bool replaceMeshCacheFile(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+// 把 mesh 的 LOD 链（mesh 自身在最前）写到 path；先写唯一命名的临时文件再原子替换，读端不会看到写了一半的文件，
+// 并发写同一缓存时后完成者胜出
+static inline bool saveMeshCache(const std::string& path, const MeshCacheKey& key, const Scene& scene, int mesh) {
+    const std::vector<int>& lods = scene.meshes[mesh].lods;
+    std::vector<MeshCacheLevel> levels(lods.size());
+    MeshCacheWriter w;
+    w.end = meshCacheAlignUp(sizeof(MeshCacheHeader) + levels.size() * sizeof(MeshCacheLevel));
+    for (size_t l = 0; l < lods.size(); ++l) {
+        const SceneMesh& m = scene.meshes[lods[l]];
+        MeshCacheLevel& L = levels[l];
+        std::memset(&L, 0, sizeof(L));
+        for (int k = 0; k < 3; ++k) {
+            L.boundsMin[k] = m.bounds.mn[k]; L.boundsMax[k] = m.bounds.mx[k];
+            L.posOffset[k] = m.qstreams.pos.offset[k]; L.posScale[k] = m.qstreams.pos.scale[k]; L.color[k] = m.qstreams.color[k];
+        }
+        L.lodError = m.lodError;
+        L.quantized = m.quantized() ? 1u : 0u;
+        L.vertexCount = m.meshlets.vertexCount;
+        if (m.quantized()) {
+            const QuantizedStreams& q = m.qstreams;
+            w.place(L.streams[0], q.px); w.place(L.streams[1], q.py); w.place(L.streams[2], q.pz);
+            w.place(L.streams[3], q.ox); w.place(L.streams[4], q.oy);
+            w.place(L.streams[5], q.u); w.place(L.streams[6], q.v); w.place(L.streams[7], q.rgb);
+        } else {
+            const VertexStreams& s = m.streams;
+            const MeshArray<float>* f[kMeshCacheStreams] = { &s.px, &s.py, &s.pz, &s.nx, &s.ny, &s.nz, &s.r, &s.g, &s.b, &s.u, &s.v };
+            for (int k = 0; k < kMeshCacheStreams; ++k) w.place(L.streams[k], *f[k]);
+        }
+        w.place(L.idx, m.idx); w.place(L.idx16, m.idx16);
+        w.place(L.meshlets, m.meshlets.meshlets); w.place(L.blocks, m.meshlets.blocks);
+    }
+
+    MeshCacheHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, kMeshCacheMagic, sizeof(h.magic));
+    h.version = kMeshCacheVersion; h.levelCount = (std::uint32_t)levels.size();
+    h.sourceHash = key.source; h.optionsHash = key.options;
+    h.fileBytes = w.end;
+    h.layout[0] = sizeof(Meshlet); h.layout[1] = sizeof(glm::ivec3); h.layout[2] = sizeof(Tri16); h.layout[3] = kMeshCacheEndianTag;
+
+    const std::string tmp = meshCacheTempPath(path);
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1 && std::fwrite(levels.data(), sizeof(MeshCacheLevel), levels.size(), f) == levels.size();
+    size_t at = sizeof(h) + levels.size() * sizeof(MeshCacheLevel);
+    static const char zeros[kMeshCacheAlign] = {};
+    for (const MeshCacheWriter::Blob& b : w.blobs) {
+        if (!ok) break;
+        ok = std::fwrite(zeros, 1, b.offset - at, f) == b.offset - at && std::fwrite(b.data, 1, b.bytes, f) == b.bytes;
+        at = b.offset + b.bytes;
+    }
+    ok = ok && std::fwrite(zeros, 1, w.end - at, f) == w.end - at;
+    ok = (std::fclose(f) == 0) && ok;
+    ok = ok && replaceMeshCacheFile(tmp, path);
+    if (!ok) std::remove(tmp.c_str());
+    return ok;
+}
+
+// 数组在文件范围内且按元素对齐时借用映射内存
+template<typename T>
+static inline bool borrowMeshCacheArray(const MappedFile& f, const MeshCacheArray& a, MeshArray<T>& out) {
+    if (a.offset % kMeshCacheAlign != 0 || a.offset > f.size() || a.count > (f.size() - a.offset) / sizeof(T)) return false;
+    out.borrow(reinterpret_cast<const T*>(f.data() + a.offset), (size_t)a.count);
+    return true;
+}
+
+// 命中时把各级依次追加到 scene.meshes（数组借用映射，映射由各级的 storage 共同持有），返回 LOD 链基础网格的编号；
+// 文件不存在、键不符或结构校验失败返回 -1，scene 不变。索引数组的内容不逐项校验（缓存只由 saveMeshCache 原子写出）
+static inline int loadMeshCache(const std::string& path, const MeshCacheKey& key, Scene& scene) {
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(path.c_str());
+    const MappedFile& f = *file;
+    if (!f.data() || f.size() < sizeof(MeshCacheHeader)) return -1;
+    MeshCacheHeader h; std::memcpy(&h, f.data(), sizeof(h));
+    if (std::memcmp(h.magic, kMeshCacheMagic, sizeof(h.magic)) != 0 || h.version != kMeshCacheVersion) return -1;
+    if (h.sourceHash != key.source || h.optionsHash != key.options || h.fileBytes != f.size()) return -1;
+    if (h.layout[0] != sizeof(Meshlet) || h.layout[1] != sizeof(glm::ivec3) || h.layout[2] != sizeof(Tri16) || h.layout[3] != kMeshCacheEndianTag) return -1;
+    if (h.levelCount == 0 || h.levelCount > (f.size() - sizeof(h)) / sizeof(MeshCacheLevel)) return -1;
+    const MeshCacheLevel* levels = reinterpret_cast<const MeshCacheLevel*>(f.data() + sizeof(h));
+
+    std::vector<SceneMesh> loaded(h.levelCount);
+    for (std::uint32_t l = 0; l < h.levelCount; ++l) {
+        const MeshCacheLevel& L = levels[l];
+        SceneMesh& m = loaded[l];
+        const size_t nv = (size_t)L.vertexCount;
+        bool ok = true;
+        if (L.quantized) {
+            QuantizedStreams& q = m.qstreams;
+            ok = borrowMeshCacheArray(f, L.streams[0], q.px) && borrowMeshCacheArray(f, L.streams[1], q.py) && borrowMeshCacheArray(f, L.streams[2], q.pz)
+                && borrowMeshCacheArray(f, L.streams[3], q.ox) && borrowMeshCacheArray(f, L.streams[4], q.oy)
+                && borrowMeshCacheArray(f, L.streams[5], q.u) && borrowMeshCacheArray(f, L.streams[6], q.v) && borrowMeshCacheArray(f, L.streams[7], q.rgb);
+            ok = ok && nv > 0 && q.px.size() == nv && q.py.size() == nv && q.pz.size() == nv && q.ox.size() == nv && q.oy.size() == nv
+                && q.u.size() == nv && q.v.size() == nv && (q.rgb.empty() || q.rgb.size() == nv);
+            for (int k = 0; k < 3; ++k) { q.pos.offset[k] = L.posOffset[k]; q.pos.scale[k] = L.posScale[k]; q.color[k] = L.color[k]; }
+        } else {
+            VertexStreams& s = m.streams;
+            MeshArray<float>* st[kMeshCacheStreams] = { &s.px, &s.py, &s.pz, &s.nx, &s.ny, &s.nz, &s.r, &s.g, &s.b, &s.u, &s.v };
+            for (int k = 0; k < kMeshCacheStreams && ok; ++k) ok = borrowMeshCacheArray(f, L.streams[k], *st[k]) && st[k]->size() == nv;
+        }
+        ok = ok && borrowMeshCacheArray(f, L.idx, m.idx) && borrowMeshCacheArray(f, L.idx16, m.idx16)
+            && borrowMeshCacheArray(f, L.meshlets, m.meshlets.meshlets) && borrowMeshCacheArray(f, L.blocks, m.meshlets.blocks);
+        ok = ok && (m.idx.empty() != m.idx16.empty()) && (m.idx16.empty() || nv <= kIndex16MaxVerts);
+        if (!ok) return -1;
+        const size_t nt = m.triCount(), nb = m.meshlets.blocks.size(), vb = vertexBlockCount(nv);
+        for (const Meshlet& ml : m.meshlets.meshlets)
+            if ((size_t)ml.triBegin + ml.triCount > nt || (size_t)ml.blockBegin + ml.blockCount > nb) return -1;
+        for (std::uint32_t b : m.meshlets.blocks) if (b >= vb) return -1;
+        m.meshlets.vertexCount = nv;
+        m.bounds.mn = glm::vec3(L.boundsMin[0], L.boundsMin[1], L.boundsMin[2]);
+        m.bounds.mx = glm::vec3(L.boundsMax[0], L.boundsMax[1], L.boundsMax[2]);
+        m.lodError = L.lodError;
+        m.storage = file;
+    }
+    const int base = (int)scene.meshes.size();
+    for (std::uint32_t l = 0; l < h.levelCount; ++l) loaded[0].lods.push_back(base + (int)l);
+    for (SceneMesh& m : loaded) scene.meshes.push_back(std::move(m));
+    return base;
+}
@@ -0,0 +1,37 @@
+#pragma once
+// 加载后的网格整理：合并逐位相同的顶点（无损）。OBJ 中下标不同、数值相同的 v/vt/vn 也共享一个顶点，顶点阶段不重复变换。
+// 不另做三角形 / 顶点重排：Scene::addMesh 切 meshlet 时会重新决定两者的顺序，SoA 顶点阶段也没有变换后缓存可利用
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+#include "mesh.hpp"
+#include "flat_hash.hpp"
+
+// 逐位比较的整个顶点
+struct VertexKey {
+    std::uint32_t bits[sizeof(VertexIn) / 4];
+    bool operator==(const VertexKey& o) const { return std::memcmp(bits, o.bits, sizeof(bits)) == 0; }
+};
+struct VertexKeyHash {
+    std::uint64_t operator()(const VertexKey& k) const {
+        std::uint32_t h = 2166136261u;
+        for (std::uint32_t b : k.bits) h = (h ^ b) * 16777619u;
+        return mixHash64(h);
+    }
+};
+
+// 合并逐位相同的顶点（保留首次出现的一个），返回合并后的顶点数
+static inline size_t mergeIdenticalVertices(std::vector<VertexIn>& verts, std::vector<glm::ivec3>& idx) {
+    FlatIndexMap<VertexKey, VertexKeyHash> ids(verts.size());
+    std::vector<int> remap(verts.size());
+    std::vector<VertexIn> out; out.reserve(verts.size());
+    for (size_t v = 0; v < verts.size(); ++v) {
+        VertexKey k; std::memcpy(k.bits, &verts[v], sizeof(k.bits));
+        remap[v] = ids.findOrInsert(k, (int)out.size());
+        if (remap[v] == (int)out.size()) out.push_back(verts[v]);
+    }
+    for (glm::ivec3& t : idx) t = glm::ivec3(remap[t.x], remap[t.y], remap[t.z]);
+    verts.swap(out);
+    return verts.size();
+}
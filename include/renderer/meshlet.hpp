@@ -0,0 +1,260 @@
+#pragma once
+// Meshlet（三角形簇）：加载时把网格切成空间上紧凑的小簇，带包围球与法线锥；
+// 每帧在顶点阶段之前按簇做视锥/光源视锥剔除与背面锥剔除，被剔除簇的顶点不做变换、三角形不进分桶
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include "mesh.hpp"
+#include "arena.hpp"
+#include "vertex_batch.hpp"
+
+static const int kMeshletMaxTris = 128;
+static const int kMeshletMaxVerts = 96; // 按不同位置计
+
+// 按位比较的顶点位置（建邻接用）
+struct PosKey {
+    std::uint32_t bits[3];
+    bool operator==(const PosKey& o) const { return bits[0] == o.bits[0] && bits[1] == o.bits[1] && bits[2] == o.bits[2]; }
+};
+struct PosKeyHash {
+    size_t operator()(const PosKey& k) const { return (size_t)((k.bits[0] * 73856093u) ^ (k.bits[1] * 19349663u) ^ (k.bits[2] * 83492791u)); }
+};
+
+struct Meshlet {
+    glm::vec3 center; float radius; // 包围球（模型空间）
+    glm::vec3 coneAxis;             // 法线锥：各三角形法线与轴的夹角余弦都 >= coneCos
+    float coneCos;                  // <= 0 表示法线过于分散，不做背面锥剔除
+    std::uint32_t triBegin, triCount;     // 重排后索引中的三角形范围
+    std::uint32_t blockBegin, blockCount; // 引用到的顶点块（kVertexBlock 个顶点一块），见 MeshletMesh::blocks
+};
+
+struct MeshletMesh {
+    MeshArray<Meshlet> meshlets;
+    MeshArray<std::uint32_t> blocks;
+    size_t vertexCount = 0;
+};
+
+// 贪心构建：从未分配的三角形出发，反复加入与当前簇共享顶点最多（其次离簇中心最近）的相邻三角形，
+// 直到三角形数或不同位置数达到上限。之后三角形按簇重排，顶点按首次使用重排（簇内顶点大多连续），verts/idx 原地改写
+static inline void buildMeshlets(std::vector<VertexIn>& verts, std::vector<glm::ivec3>& idx, MeshletMesh& out) {
+    const int nt = (int)idx.size(), nv = (int)verts.size();
+    out.meshlets.clear(); out.blocks.clear(); out.vertexCount = verts.size();
+    if (nt == 0) return;
+
+    // 邻接按位置建立：顶点按 v/vt/vn 整体去重，UV/法线接缝两侧（以及未给法线的逐面顶点）位置相同但编号不同
+    std::vector<int> posId(nv);
+    int np = 0;
+    {
+        std::unordered_map<PosKey, int, PosKeyHash> ids; ids.reserve(nv);
+        for (int v = 0; v < nv; ++v) {
+            PosKey k; std::memcpy(k.bits, &verts[v].pos, sizeof(k.bits));
+            posId[v] = ids.emplace(k, np).first->second;
+            if (posId[v] == np) ++np;
+        }
+    }
+    // 位置 -> 三角形邻接（CSR）
+    std::vector<int> adjStart(np + 1, 0), adj((size_t)nt * 3);
+    for (const glm::ivec3& t : idx) for (int k = 0; k < 3; ++k) ++adjStart[posId[t[k]] + 1];
+    for (int p = 0; p < np; ++p) adjStart[p + 1] += adjStart[p];
+    { std::vector<int> fill(adjStart.begin(), adjStart.end() - 1);
+      for (int t = 0; t < nt; ++t) for (int k = 0; k < 3; ++k) adj[fill[posId[idx[t][k]]]++] = t; }
+
+    std::vector<glm::vec3> centroid(nt);
+    for (int t = 0; t < nt; ++t) centroid[t] = (verts[idx[t].x].pos + verts[idx[t].y].pos + verts[idx[t].z].pos) * (1.0f / 3.0f);
+
+    std::vector<int> posStamp(np, -1), candStamp(nt, -1), order; order.reserve(nt);
+    std::vector<std::uint8_t> assigned(nt, 0);
+    std::vector<int> cand;
+    std::vector<std::uint32_t> clusterStart;
+    int seed = 0, cluster = 0;
+    for (;; ++cluster) {
+        while (seed < nt && assigned[seed]) ++seed;
+        if (seed >= nt) break;
+        int next = seed;
+        clusterStart.push_back((std::uint32_t)order.size());
+        cand.clear();
+        int clusterVerts = 0; // 簇内不同位置数
+        glm::vec3 sum(0.0f); int count = 0;
+        while (next >= 0) {
+            assigned[next] = 1; order.push_back(next); sum += centroid[next]; ++count;
+            for (int k = 0; k < 3; ++k) {
+                int p = posId[idx[next][k]];
+                if (posStamp[p] == cluster) continue;
+                posStamp[p] = cluster; ++clusterVerts;
+                for (int a = adjStart[p]; a < adjStart[p + 1]; ++a) {
+                    int t = adj[a];
+                    if (!assigned[t] && candStamp[t] != cluster) { candStamp[t] = cluster; cand.push_back(t); }
+                }
+            }
+            if (count >= kMeshletMaxTris) break;
+            glm::vec3 c = sum * (1.0f / (float)count);
+            int best = -1, bestShared = -1; float bestDist = 0.0f;
+            for (size_t i = 0; i < cand.size();) {
+                int t = cand[i];
+                if (assigned[t]) { cand[i] = cand.back(); cand.pop_back(); continue; }
+                int shared = (posStamp[posId[idx[t].x]] == cluster) + (posStamp[posId[idx[t].y]] == cluster) + (posStamp[posId[idx[t].z]] == cluster);
+                if (clusterVerts + (3 - shared) <= kMeshletMaxVerts) {
+                    glm::vec3 d = centroid[t] - c; float dist = glm::dot(d, d);
+                    if (shared > bestShared || (shared == bestShared && dist < bestDist)) { best = t; bestShared = shared; bestDist = dist; }
+                }
+                ++i;
+            }
+            next = best;
+        }
+    }
+    clusterStart.push_back((std::uint32_t)order.size());
+
+    // 三角形按簇重排，顶点按首次使用重排
+    std::vector<glm::ivec3> newIdx(nt);
+    std::vector<int> remap(nv, -1); std::vector<VertexIn> newVerts; newVerts.reserve(nv);
+    for (int i = 0; i < nt; ++i) {
+        glm::ivec3 t = idx[order[i]];
+        for (int k = 0; k < 3; ++k) {
+            int& r = remap[t[k]];
+            if (r < 0) { r = (int)newVerts.size(); newVerts.push_back(verts[t[k]]); }
+            t[k] = r;
+        }
+        newIdx[i] = t;
+    }
+    for (int v = 0; v < nv; ++v) if (remap[v] < 0) newVerts.push_back(verts[v]); // 未被引用的顶点放在最后
+    verts.swap(newVerts); idx.swap(newIdx);
+
+    std::vector<std::uint32_t> blockStamp(vertexBlockCount(verts.size()), 0xffffffffu);
+    std::vector<Meshlet> meshlets; std::vector<std::uint32_t> blocks;
+    for (size_t m = 0; m + 1 < clusterStart.size(); ++m) {
+        Meshlet ml{};
+        ml.triBegin = clusterStart[m]; ml.triCount = clusterStart[m + 1] - clusterStart[m];
+        ml.blockBegin = (std::uint32_t)blocks.size();
+        glm::vec3 mn(1e30f), mx(-1e30f), nsum(0.0f);
+        for (std::uint32_t t = ml.triBegin; t < ml.triBegin + ml.triCount; ++t) {
+            const glm::ivec3& tri = idx[t];
+            for (int k = 0; k < 3; ++k) {
+                mn = glm::min(mn, verts[tri[k]].pos); mx = glm::max(mx, verts[tri[k]].pos);
+                std::uint32_t b = (std::uint32_t)tri[k] / kVertexBlock;
+                if (blockStamp[b] != (std::uint32_t)m) { blockStamp[b] = (std::uint32_t)m; blocks.push_back(b); }
+            }
+            glm::vec3 n = glm::cross(verts[tri.y].pos - verts[tri.x].pos, verts[tri.z].pos - verts[tri.x].pos);
+            float len = glm::length(n);
+            if (len > 0.0f) nsum += n / len;
+        }
+        ml.blockCount = (std::uint32_t)blocks.size() - ml.blockBegin;
+        ml.center = (mn + mx) * 0.5f; ml.radius = 0.0f;
+        for (std::uint32_t t = ml.triBegin; t < ml.triBegin + ml.triCount; ++t)
+            for (int k = 0; k < 3; ++k) ml.radius = std::max(ml.radius, glm::length(verts[idx[t][k]].pos - ml.center));
+        // 法线锥：轴取单位法线之和的方向，余弦取最小值；退化三角形不参与（面积为 0，光栅阶段本来就丢弃）
+        float nlen = glm::length(nsum);
+        ml.coneAxis = nlen > 0.0f ? nsum / nlen : glm::vec3(0.0f, 0.0f, 1.0f);
+        ml.coneCos = nlen > 0.0f ? 1.0f : -1.0f;
+        for (std::uint32_t t = ml.triBegin; t < ml.triBegin + ml.triCount && nlen > 0.0f; ++t) {
+            const glm::ivec3& tri = idx[t];
+            glm::vec3 n = glm::cross(verts[tri.y].pos - verts[tri.x].pos, verts[tri.z].pos - verts[tri.x].pos);
+            float len = glm::length(n);
+            if (len > 0.0f) ml.coneCos = std::min(ml.coneCos, glm::dot(n / len, ml.coneAxis));
+        }
+        meshlets.push_back(ml);
+    }
+    out.meshlets = std::move(meshlets); out.blocks = std::move(blocks);
+}
+
+// 保守余量：簇级判定在浮点舍入下也不能剔掉逐三角形判定会保留的三角形
+static const float kConeCosMargin = 1e-3f;
+static const float kCullRadiusScale = 1.001f;
+
+// 一个通道在模型空间的剔除参数
+struct MeshletCullView {
+    glm::vec4 planes[6];  // 由裁剪矩阵 (VP * M) 提取的模型空间平面
+    glm::vec3 eye;        // 透视：相机位置；正交：观察方向（单位向量，从光源指向场景）
+    bool perspective;
+    int cullFaces;        // 0 不剔除，1 剔除背面，-1 剔除正面（阴影通道）
+};
+
+// clipM = VP * M；eyeOrDirWS 为世界空间相机位置（透视）或观察方向（正交）。M 含镜像时不做朝向剔除
+static inline MeshletCullView makeMeshletCullView(const glm::mat4& clipM, const glm::mat4& M, const glm::vec3& eyeOrDirWS,
+    bool perspective, int cullFaces) {
+    MeshletCullView v;
+    extractFrustumPlanes(clipM, v.planes);
+    glm::mat4 invM = glm::inverse(M);
+    v.perspective = perspective;
+    v.eye = perspective ? glm::vec3(invM * glm::vec4(eyeOrDirWS, 1.0f)) : glm::normalize(glm::vec3(invM * glm::vec4(eyeOrDirWS, 0.0f)));
+    v.cullFaces = (glm::determinant(glm::mat3(M)) > 0.0f) ? cullFaces : 0;
+    return v;
+}
+
+// 簇是否可能有三角形通过该通道的逐三角形剔除（视锥外码 + 正/背面）
+static inline bool meshletVisible(const Meshlet& m, const MeshletCullView& v) {
+    float r = m.radius * kCullRadiusScale;
+    for (int p = 0; p < 6; ++p) {
+        const glm::vec4& P = v.planes[p];
+        if (glm::dot(glm::vec3(P), m.center) + P.w < -r) return false;
+    }
+    if (v.cullFaces == 0 || m.coneCos <= kConeCosMargin) return true;
+    float c = m.coneCos - kConeCosMargin, s = std::sqrt(1.0f - c * c);
+    if (v.perspective) {
+        // 所有三角形都背对相机：对锥内任意法线 n 与球内任意点 p，n·(p - eye) > 0
+        glm::vec3 d = m.center - v.eye;
+        float along = glm::dot(d, m.coneAxis), perp = std::sqrt(std::max(glm::dot(d, d) - along * along, 0.0f));
+        if (v.cullFaces > 0) return !(along * c - perp * s > r);
+        return !(along * c + perp * s < -r); // 所有三角形都正对：n·(p - eye) < 0
+    }
+    // 正交：朝向只取决于法线与观察方向 dir，背面 n·dir > 0
+    float along = glm::dot(v.eye, m.coneAxis);
+    if (v.cullFaces > 0) return !(along > s);
+    return !(along < -s);
+}
+
+// 一帧内某网格的 meshlet 剔除结果（内存来自帧内存）
+struct MeshletFrame {
+    const glm::ivec3* camIdx = nullptr; size_t camTris = 0;     // 相机可见簇的三角形，保持簇顺序
+    const glm::ivec3* lightIdx = nullptr; size_t lightTris = 0; // 光源可见簇的三角形
+    const std::uint8_t* camBlocks = nullptr;   // 相机通道需要变换的顶点块；为空表示全部
+    const std::uint8_t* lightBlocks = nullptr; // 需要光空间顶点的块：光源可见 ∪ 相机可见（相机通道的 lightClip 也取自这里）
+    size_t visibleMeshlets = 0, lightMeshlets = 0;
+};
+
+// 可见簇的三角形拷到帧内存：32 位索引整段拷贝，16 位索引（Tri16）在这里展开
+static inline void copyTris(glm::ivec3* dst, const glm::ivec3* src, size_t n) { std::memcpy(dst, src, n * sizeof(glm::ivec3)); }
+static inline void copyTris(glm::ivec3* dst, const Tri16* src, size_t n) { for (size_t t = 0; t < n; ++t) dst[t] = expandTri(src[t]); }
+
+// cam / light 为空表示该通道整体不可见（对象级已剔除）。Tri 为 glm::ivec3 或 Tri16
+template<typename Tri>
+static inline MeshletFrame cullMeshlets(const MeshletMesh& mm, const Tri* idx, const MeshletCullView* cam, const MeshletCullView* light, FrameArena& arena) {
+    MeshletFrame f;
+    size_t nb = vertexBlockCount(mm.vertexCount), nt = 0;
+    for (const Meshlet& m : mm.meshlets) nt += m.triCount;
+    glm::ivec3* camIdx = arena.allocArray<glm::ivec3>(nt); glm::ivec3* lightIdx = arena.allocArray<glm::ivec3>(nt);
+    std::uint8_t* camBlocks = arena.allocArray<std::uint8_t>(nb); std::uint8_t* lightBlocks = arena.allocArray<std::uint8_t>(nb);
+    std::memset(camBlocks, 0, nb); std::memset(lightBlocks, 0, nb);
+    for (const Meshlet& m : mm.meshlets) {
+        bool inCam = cam && meshletVisible(m, *cam), inLight = light && meshletVisible(m, *light);
+        if (inCam) { copyTris(camIdx + f.camTris, idx + m.triBegin, m.triCount); f.camTris += m.triCount; ++f.visibleMeshlets; }
+        if (inLight) { copyTris(lightIdx + f.lightTris, idx + m.triBegin, m.triCount); f.lightTris += m.triCount; ++f.lightMeshlets; }
+        if (!inCam && !inLight) continue;
+        for (std::uint32_t i = m.blockBegin; i < m.blockBegin + m.blockCount; ++i) {
+            std::uint32_t b = mm.blocks[i];
+            lightBlocks[b] = 1;
+            if (inCam) camBlocks[b] = 1;
+        }
+    }
+    f.camIdx = camIdx; f.lightIdx = lightIdx; f.camBlocks = camBlocks; f.lightBlocks = lightBlocks;
+    return f;
+}
+
+// 不做簇剔除：可见通道取全部三角形与顶点
+static inline MeshletFrame allMeshlets(const MeshletMesh& mm, const glm::ivec3* idx, size_t triCount, bool inCam, bool inLight) {
+    MeshletFrame f;
+    if (inCam) { f.camIdx = idx; f.camTris = triCount; f.visibleMeshlets = mm.meshlets.size(); }
+    if (inLight) { f.lightIdx = idx; f.lightTris = triCount; f.lightMeshlets = mm.meshlets.size(); }
+    return f;
+}
+
+// 16 位索引：先展开到帧内存（两个通道共用一份）
+static inline MeshletFrame allMeshlets(const MeshletMesh& mm, const Tri16* idx, size_t triCount, bool inCam, bool inLight, FrameArena& arena) {
+    if (!inCam && !inLight) return MeshletFrame();
+    glm::ivec3* tris = arena.allocArray<glm::ivec3>(triCount);
+    copyTris(tris, idx, triCount);
+    return allMeshlets(mm, tris, triCount, inCam, inLight);
+}
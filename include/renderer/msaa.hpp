@@ -0,0 +1,336 @@
+#pragma once
+// 覆盖掩码多重采样（MSAA 4x/8x）：深度与三角形编号按采样点存储，解析时每个像素对覆盖它的每个三角形只着色一次，
+// 再按采样点平均写入帧缓冲
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "simd.hpp"
+#include "raster_row.hpp"
+#include "raster.hpp"
+#include "visbuffer.hpp"
+#include "binning.hpp"
+#include "common.hpp"
+
+static const int kMsaaMaxSamples = 8;
+// 采样点离像素中心的最大偏移（1/16 像素）：包围盒与分块须外扩这么多
+static const int kMsaaSampleReach = kSubPixelHalf;
+
+// 标准 4x/8x 采样位置（D3D 图样），相对像素中心，单位 1/16 像素：与 28.4 定点一致，边函数可精确求值
+static inline const glm::ivec2* msaaSamplePattern(int samples) {
+    static const glm::ivec2 p4[4] = { { -2, -6 }, { 6, -2 }, { -6, 2 }, { 2, 6 } };
+    static const glm::ivec2 p8[8] = { { 1, -3 }, { -1, 3 }, { 5, 1 }, { -3, -5 }, { -5, 5 }, { -7, -1 }, { 3, 7 }, { 7, -7 } };
+    return samples == 8 ? p8 : p4;
+}
+
+// 每像素 samples 个采样点连续存放：下标 (y * w + x) * samples + s
+struct MsaaBuffer {
+    int w = 0, h = 0, samples = 0;
+    std::vector<float> z;
+    std::vector<std::uint32_t> id; // 同 VisBuffer，kVisEmpty 为背景
+    std::vector<std::uint32_t> color; // 一帧分多轮解析时保留各采样点的颜色，用到时才分配（sampleColors）
+    void resize(int W, int H, int S) {
+        w = W; h = H; samples = S;
+        z.assign((size_t)W * H * S, 1.0f); id.assign((size_t)W * H * S, kVisEmpty);
+        color.clear();
+    }
+    void clear(const RectI& r) {
+        for (int y = r.y0; y <= r.y1; ++y) {
+            size_t b = ((size_t)y * w + r.x0) * samples, e = ((size_t)y * w + r.x1 + 1) * samples;
+            std::fill(&z[b], &z[0] + e, 1.0f); std::fill(&id[b], &id[0] + e, kVisEmpty);
+        }
+    }
+    // 只清三角形编号，深度留给下一轮
+    void clearIds(const RectI& r) {
+        for (int y = r.y0; y <= r.y1; ++y) {
+            size_t b = ((size_t)y * w + r.x0) * samples, e = ((size_t)y * w + r.x1 + 1) * samples;
+            std::fill(&id[b], &id[0] + e, kVisEmpty);
+        }
+    }
+    std::uint32_t* sampleColors() {
+        if (color.size() != id.size()) color.resize(id.size());
+        return color.data();
+    }
+};
+
+// 三角形在一行上的采样点状态。采样点 s 的边函数 = 像素中心值 + offE[k][s]，深度 = 像素中心深度 + dz[s]
+struct MsaaRowIn {
+    int samples;
+    std::int64_t E[3], stepX[3];             // x0 处像素中心的边函数（已含 bias）
+    std::int64_t offE[3][kMsaaMaxSamples];
+    float dz[kMsaaMaxSamples];
+    int ox;                                  // 深度平面原点 x
+    float zRow, dzdx, zLo, zHi;              // 同 RasterRowIn
+    std::uint32_t triId;
+};
+
+// 处理像素 [x0, x1]：覆盖且深度通过的采样点写入深度与 triId。zrow/idrow 指向该行第 0 个像素的第 0 个采样点
+typedef void (*MsaaRowFn)(const MsaaRowIn& in, int x0, int x1, float* zrow, std::uint32_t* idrow);
+
+static inline void msaaRowScalarAt(const MsaaRowIn& in, int xStart, int x0, int x1, float* zrow, std::uint32_t* idrow) {
+    const int S = in.samples;
+    std::int64_t E0 = in.E[0] + (x0 - xStart) * in.stepX[0];
+    std::int64_t E1 = in.E[1] + (x0 - xStart) * in.stepX[1];
+    std::int64_t E2 = in.E[2] + (x0 - xStart) * in.stepX[2];
+    for (int x = x0; x <= x1; ++x, E0 += in.stepX[0], E1 += in.stepX[1], E2 += in.stepX[2]) {
+        float zc = in.zRow + float(x - in.ox) * in.dzdx;
+        for (int s = 0; s < S; ++s) {
+            if (((E0 + in.offE[0][s]) | (E1 + in.offE[1][s]) | (E2 + in.offE[2][s])) < 0) continue;
+            float z = zc + in.dz[s];
+            z = std::min(std::max(z, in.zLo), in.zHi);
+            size_t i = (size_t)x * S + s;
+            if (z < zrow[i]) { zrow[i] = z; idrow[i] = in.triId; }
+        }
+    }
+}
+
+static inline void msaaRowScalar(const MsaaRowIn& in, int x0, int x1, float* zrow, std::uint32_t* idrow) {
+    msaaRowScalarAt(in, x0, x0, x1, zrow, idrow);
+}
+
+// 采样点偏移最多半个像素，edgesFitInt32 之外还要求 stepY 有界（包围盒只有一行时角点不约束它）
+static inline bool msaaEdgesFitInt32(const EdgeFx* e, int spanX, int spanY) {
+    const std::int64_t lim = std::int64_t(1) << 29;
+    for (int k = 0; k < 3; ++k) if (e[k].stepY >= lim || e[k].stepY <= -lim) return false;
+    return edgesFitInt32(e, spanX, spanY);
+}
+
+#if RENDERER_X86
+// 4 个采样点为一个向量：4x 每像素一个，8x 每像素两个
+RENDERER_TARGET_SSE41
+static void msaaRowSSE41(const MsaaRowIn& in, int x0, int x1, float* zrow, std::uint32_t* idrow) {
+    const int S = in.samples, NV = S / 4;
+    __m128i off[3][2]; __m128 dz[2];
+    for (int v = 0; v < NV; ++v) {
+        for (int k = 0; k < 3; ++k)
+            off[k][v] = _mm_setr_epi32((int)in.offE[k][4 * v], (int)in.offE[k][4 * v + 1], (int)in.offE[k][4 * v + 2], (int)in.offE[k][4 * v + 3]);
+        dz[v] = _mm_loadu_ps(&in.dz[4 * v]);
+    }
+    const __m128 zLo = _mm_set1_ps(in.zLo), zHi = _mm_set1_ps(in.zHi), id = _mm_castsi128_ps(_mm_set1_epi32((int)in.triId));
+    int E0 = (int)in.E[0], E1 = (int)in.E[1], E2 = (int)in.E[2];
+    for (int x = x0; x <= x1; ++x, E0 += (int)in.stepX[0], E1 += (int)in.stepX[1], E2 += (int)in.stepX[2]) {
+        const __m128i e0 = _mm_set1_epi32(E0), e1 = _mm_set1_epi32(E1), e2 = _mm_set1_epi32(E2);
+        const __m128 zc = _mm_set1_ps(in.zRow + float(x - in.ox) * in.dzdx);
+        for (int v = 0; v < NV; ++v) {
+            __m128i e = _mm_or_si128(_mm_or_si128(_mm_add_epi32(e0, off[0][v]), _mm_add_epi32(e1, off[1][v])), _mm_add_epi32(e2, off[2][v]));
+            __m128 outside = _mm_castsi128_ps(_mm_srai_epi32(e, 31));
+            if (_mm_movemask_ps(outside) == 0xF) continue;
+            __m128 z = _mm_min_ps(_mm_max_ps(_mm_add_ps(zc, dz[v]), zLo), zHi);
+            float* zp = zrow + (size_t)x * S + 4 * v; float* ip = (float*)(idrow + (size_t)x * S + 4 * v);
+            __m128 zref = _mm_loadu_ps(zp);
+            __m128 pass = _mm_andnot_ps(outside, _mm_cmplt_ps(z, zref));
+            _mm_storeu_ps(zp, _mm_blendv_ps(zref, z, pass));
+            _mm_storeu_ps(ip, _mm_blendv_ps(_mm_loadu_ps(ip), id, pass));
+        }
+    }
+}
+
+// 8 个采样点为一个向量：8x 每像素一个，4x 每两个像素一个（奇数尾像素走标量）
+RENDERER_TARGET_AVX2
+static void msaaRowAVX2(const MsaaRowIn& in, int x0, int x1, float* zrow, std::uint32_t* idrow) {
+    const int S = in.samples, P = 8 / S; // 每个向量覆盖的像素数
+    __m256i off[3], stepE[3]; __m256 dz;
+    alignas(32) int o[8]; alignas(32) float d[8];
+    for (int k = 0; k < 3; ++k) {
+        for (int l = 0; l < 8; ++l) o[l] = (int)(in.offE[k][l % S] + (l / S) * in.stepX[k]);
+        off[k] = _mm256_load_si256((const __m256i*)o);
+        stepE[k] = _mm256_set1_epi32((int)(in.stepX[k] * P));
+    }
+    for (int l = 0; l < 8; ++l) d[l] = in.dz[l % S];
+    dz = _mm256_load_ps(d);
+    const __m256 zLo = _mm256_set1_ps(in.zLo), zHi = _mm256_set1_ps(in.zHi), id = _mm256_castsi256_ps(_mm256_set1_epi32((int)in.triId));
+    __m256i e[3];
+    for (int k = 0; k < 3; ++k) e[k] = _mm256_add_epi32(_mm256_set1_epi32((int)in.E[k]), off[k]);
+    int x = x0;
+    for (; x + P - 1 <= x1; x += P) {
+        __m256 outside = _mm256_castsi256_ps(_mm256_srai_epi32(_mm256_or_si256(_mm256_or_si256(e[0], e[1]), e[2]), 31));
+        for (int k = 0; k < 3; ++k) e[k] = _mm256_add_epi32(e[k], stepE[k]);
+        if (_mm256_movemask_ps(outside) == 0xFF) continue;
+        // 像素中心深度与标量版同样逐像素求值，保证结果逐位相同
+        float zc0 = in.zRow + float(x - in.ox) * in.dzdx, zc1 = (P == 2) ? in.zRow + float(x + 1 - in.ox) * in.dzdx : zc0;
+        __m256 zc = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(zc0)), _mm_set1_ps(zc1), 1);
+        __m256 z = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(zc, dz), zLo), zHi);
+        float* zp = zrow + (size_t)x * S; float* ip = (float*)(idrow + (size_t)x * S);
+        __m256 zref = _mm256_loadu_ps(zp);
+        __m256 pass = _mm256_andnot_ps(outside, _mm256_cmp_ps(z, zref, _CMP_LT_OQ));
+        _mm256_storeu_ps(zp, _mm256_blendv_ps(zref, z, pass));
+        _mm256_storeu_ps(ip, _mm256_blendv_ps(_mm256_loadu_ps(ip), id, pass));
+    }
+    if (x <= x1) msaaRowScalarAt(in, x0, x, x1, zrow, idrow);
+}
+#endif
+
+static inline MsaaRowFn msaaRowFnFor(SimdLevel l) {
+#if RENDERER_X86
+    if (l == SimdLevel::AVX2) return msaaRowAVX2;
+    if (l == SimdLevel::SSE41) return msaaRowSSE41;
+#else
+    (void)l;
+#endif
+    return msaaRowScalar;
+}
+
+// 包围盒按采样点外扩；不走 HiZ 与小三角形路径（二者都按像素中心判断）
+static inline void rasterTriangleMsaa(const VertexOut& V0, const VertexOut& V1, const VertexOut& V2, std::uint32_t triId,
+    MsaaBuffer& mb, bool enableCull, const RectI& clip) {
+    if (!acceptTriangleTex(V0, V1, V2, enableCull)) return;
+
+    const VertexOut* v0 = &V0; const VertexOut* v1 = &V1; const VertexOut* v2 = &V2;
+    glm::ivec2 p0 = v0->screen, p1 = v1->screen, p2 = v2->screen;
+    std::int64_t area = edgeFunctionFx(p0, p1, p2); if (area == 0) return; if (area < 0) { std::swap(v1, v2); std::swap(p1, p2); area = -area; }
+
+    const int R = kMsaaSampleReach;
+    int minX = std::max(clip.x0, fxFirstPixel(std::min(p0.x, std::min(p1.x, p2.x)) - R));
+    int maxX = std::min(clip.x1, fxLastPixel(std::max(p0.x, std::max(p1.x, p2.x)) + R));
+    int minY = std::max(clip.y0, fxFirstPixel(std::min(p0.y, std::min(p1.y, p2.y)) - R));
+    int maxY = std::min(clip.y1, fxLastPixel(std::max(p0.y, std::max(p1.y, p2.y)) + R));
+    if (minX > maxX || minY > maxY) return;
+
+    EdgeFx e[3] = { setupEdgeFx(p1, p2, minX, minY), setupEdgeFx(p2, p0, minX, minY), setupEdgeFx(p0, p1, minX, minY) };
+    PlaneSetup ps = setupPlanes(e, minX, minY, area, p0, p1, p2, mb.w, mb.h);
+    MsaaRowIn in; AttrPlane zPlane;
+    setupDepthPlane(zPlane, in.zLo, in.zHi, ps, *v0, *v1, *v2);
+    const int S = mb.samples;
+    const glm::ivec2* pat = msaaSamplePattern(S);
+    in.samples = S; in.ox = ps.ox; in.dzdx = zPlane.dx; in.triId = triId;
+    for (int k = 0; k < 3; ++k) {
+        in.stepX[k] = e[k].stepX;
+        // stepX/stepY 是 1/16 像素增量的 16 倍，整除精确
+        for (int s = 0; s < S; ++s) in.offE[k][s] = (pat[s].x * e[k].stepX + pat[s].y * e[k].stepY) / kSubPixelScale;
+    }
+    for (int s = 0; s < S; ++s) in.dz[s] = (zPlane.dx * float(pat[s].x) + zPlane.dy * float(pat[s].y)) * (1.0f / kSubPixelScale);
+    MsaaRowFn rowFn = msaaEdgesFitInt32(e, maxX - minX, maxY - minY) ? msaaRowFnFor(rasterSimdLevel()) : msaaRowScalar;
+
+    for (int y = minY; y <= maxY; ++y) {
+        for (int k = 0; k < 3; ++k) in.E[k] = edgeAt(e[k], minX, minY, minX, y);
+        in.zRow = zPlane.c + zPlane.dy * float(y - ps.oy);
+        rowFn(in, minX, maxX, &mb.z[(size_t)y * mb.w * S], &mb.id[(size_t)y * mb.w * S]);
+    }
+}
+
+// 采样点颜色 -> 像素颜色：n 个像素，每像素 S 个 ARGB 连续存放，各通道取平均（四舍五入）
+typedef void (*MsaaAverageFn)(const std::uint32_t* samples, int n, int S, std::uint32_t* out);
+
+static inline void msaaAverageScalar(const std::uint32_t* samples, int n, int S, std::uint32_t* out) {
+    const int shift = (S == 8) ? 3 : 2;
+    for (int i = 0; i < n; ++i, samples += S) {
+        std::uint32_t c = 0;
+        for (int ch = 0; ch < 32; ch += 8) {
+            std::uint32_t sum = 0;
+            for (int s = 0; s < S; ++s) sum += (samples[s] >> ch) & 0xffu;
+            c |= ((sum + (std::uint32_t)(S / 2)) >> shift) << ch;
+        }
+        out[i] = c;
+    }
+}
+
+#if RENDERER_X86
+// 通道扩展到 16 位后累加：4 个采样点的和在低 64 位
+RENDERER_TARGET_SSE41
+static void msaaAverageSSE41(const std::uint32_t* samples, int n, int S, std::uint32_t* out) {
+    const __m128i zero = _mm_setzero_si128(), half = _mm_set1_epi16((short)(S / 2));
+    const __m128i shift = _mm_cvtsi32_si128((S == 8) ? 3 : 2);
+    for (int i = 0; i < n; ++i, samples += S) {
+        __m128i sum = zero;
+        for (int s = 0; s < S; s += 4) {
+            __m128i c = _mm_loadu_si128((const __m128i*)(samples + s));
+            sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_unpacklo_epi8(c, zero), _mm_unpackhi_epi8(c, zero)));
+        }
+        sum = _mm_add_epi16(sum, _mm_srli_si128(sum, 8));
+        sum = _mm_srl_epi16(_mm_add_epi16(sum, half), shift);
+        out[i] = (std::uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+    }
+}
+
+// 一次处理 8 个采样点（8x 一个像素、4x 两个像素），128 位两半各自累加
+RENDERER_TARGET_AVX2
+static void msaaAverageAVX2(const std::uint32_t* samples, int n, int S, std::uint32_t* out) {
+    const __m256i zero = _mm256_setzero_si256(), half = _mm256_set1_epi16((short)(S / 2));
+    const __m128i shift = _mm_cvtsi32_si128((S == 8) ? 3 : 2);
+    const int P = 8 / S;
+    int i = 0;
+    for (; i + P <= n; i += P, samples += 8) {
+        __m256i c = _mm256_loadu_si256((const __m256i*)samples);
+        __m256i sum = _mm256_add_epi16(_mm256_unpacklo_epi8(c, zero), _mm256_unpackhi_epi8(c, zero));
+        sum = _mm256_add_epi16(sum, _mm256_srli_si256(sum, 8));
+        if (P == 1) sum = _mm256_add_epi16(sum, _mm256_permute2x128_si256(sum, sum, 1));
+        sum = _mm256_srl_epi16(_mm256_add_epi16(sum, half), shift);
+        __m256i packed = _mm256_packus_epi16(sum, sum);
+        out[i] = (std::uint32_t)_mm256_extract_epi32(packed, 0);
+        if (P == 2) out[i + 1] = (std::uint32_t)_mm256_extract_epi32(packed, 4);
+    }
+    if (i < n) msaaAverageScalar(samples, n - i, S, out + i);
+}
+#endif
+
+static inline MsaaAverageFn msaaAverageFnFor(SimdLevel l) {
+#if RENDERER_X86
+    if (l == SimdLevel::AVX2) return msaaAverageAVX2;
+    if (l == SimdLevel::SSE41) return msaaAverageSSE41;
+#else
+    (void)l;
+#endif
+    return msaaAverageScalar;
+}
+
+// 解析矩形 r：逐像素找出不同的三角形编号，每个三角形在像素中心着色一次（Depth 模式取其第一个采样点的深度），
+// 颜色填到它覆盖的采样点后按行平均。参数同 ResolveVisFn；分多轮时 history 非空（sampleColors）：
+// 各采样点颜色写回其中，非第一轮没有新三角形的采样点沿用它
+typedef void (*ResolveMsaaFn)(const MsaaBuffer& mb, const TileBins<VertexOut>& tb, const RectI& r,
+    const Texture2D* const* drawTex, Framebuffer& fb, std::uint32_t clearColor, bool firstRound, std::uint32_t* history,
+    const DepthBuffer& shadowMap, const glm::vec3& Ldir, const glm::vec3& ambient, const glm::vec3& lightColor);
+
+template<ShadingMode Mode, bool Bilinear, bool Shadows, bool Lighting>
+struct ResolveMsaaKernel {
+    typedef ResolveMsaaFn Fn;
+    static void run(const MsaaBuffer& mb, const TileBins<VertexOut>& tb, const RectI& r,
+        const Texture2D* const* drawTex, Framebuffer& fb, std::uint32_t clearColor, bool firstRound, std::uint32_t* history,
+        const DepthBuffer& shadowMap, const glm::vec3& Ldir, const glm::vec3& ambient, const glm::vec3& lightColor) {
+        const int S = mb.samples;
+        const MsaaAverageFn average = msaaAverageFnFor(rasterSimdLevel());
+        std::uint32_t cur = kVisEmpty; ShadePlanes sp; PlaneSetup ps; const Texture2D* tex = nullptr;
+        auto shade = [&](std::uint32_t id, int x, int y, float z) {
+            if (id != cur) {
+                const BinChunk<VertexOut>& c = tb.chunkOf(id);
+                const glm::ivec3& tri = tb.triangle(id);
+                setupVisTriangle<Mode, Shadows, Lighting>(sp, ps, c.vert(tri.x), c.vert(tri.y), c.vert(tri.z), mb.w, mb.h);
+                tex = drawTex[c.draw]; cur = id;
+            }
+            return shadeFragmentT<Mode, Bilinear, Shadows, Lighting>(sp, float(x - ps.ox), float(y - ps.oy), z, *tex, shadowMap, Ldir, ambient, lightColor);
+        };
+        std::uint32_t colors[kRowSpan * kMsaaMaxSamples];
+        for (int y = r.y0; y <= r.y1; ++y) {
+            for (int xs = r.x0; xs <= r.x1; xs += kRowSpan) {
+                int xe = std::min(r.x1, xs + kRowSpan - 1);
+                for (int x = xs; x <= xe; ++x) {
+                    const std::uint32_t* ids = &mb.id[((size_t)y * mb.w + x) * S];
+                    const float* zs = &mb.z[((size_t)y * mb.w + x) * S];
+                    std::uint32_t* c = &colors[(x - xs) * S];
+                    int s = 1; while (s < S && ids[s] == ids[0]) ++s;
+                    if (!firstRound && s == S && ids[0] == kVisEmpty) { // 本轮没有新三角形：沿用上一轮
+                        std::memcpy(c, &history[((size_t)y * mb.w + x) * S], S * sizeof(std::uint32_t));
+                        continue;
+                    }
+                    if (s == S) { // 内部像素：只有一个三角形（或背景）
+                        std::uint32_t col = (ids[0] == kVisEmpty) ? clearColor : shade(ids[0], x, y, zs[0]);
+                        for (int k = 0; k < S; ++k) c[k] = col;
+                        continue;
+                    }
+                    const std::uint32_t* prev = firstRound ? nullptr : &history[((size_t)y * mb.w + x) * S];
+                    for (s = 0; s < S; ++s) { // 边缘像素：同一三角形的采样点沿用第一次的结果
+                        if (ids[s] == kVisEmpty && prev) { c[s] = prev[s]; continue; }
+                        int t = 0; while (ids[t] != ids[s]) ++t;
+                        c[s] = (t < s) ? c[t] : (ids[s] == kVisEmpty ? clearColor : shade(ids[s], x, y, zs[s]));
+                    }
+                }
+                if (history) std::memcpy(&history[((size_t)y * mb.w + xs) * S], colors, (size_t)(xe - xs + 1) * S * sizeof(std::uint32_t));
+                average(colors, xe - xs + 1, S, &fb.pixels[(size_t)y * fb.w + xs]);
+            }
+        }
+    }
+};
+
+static inline ResolveMsaaFn resolveMsaaFnFor(ShadingMode mode, bool bilinear, bool enableShadows, bool enableLighting) {
+    return selectShadeKernel<ResolveMsaaKernel>(mode, bilinear, enableShadows, enableLighting);
+}
@@ -1,24 +1,47 @@
 #pragma once
-//  OBJ ȡ֧ v/vt/vnǻȱʧԶɣλΧΪ 1
+// 极简 OBJ 读取（支持 v/vt/vn，三角化，法线缺失则自动生成，单位化到包围盒最大边为 1）；文件内存映射后在缓冲区上原地解析。
+// 相同的 v/vt/vn 三元组在整个网格内只生成一个顶点（缺 vn 的角点默认只在本面内共享，见 smoothGeneratedNormals）；mergeVertices 时再合并逐位相同的顶点（见 mesh_opt.hpp）
 #include <vector>
 #include <glm/glm.hpp>
 
 #include "mesh.hpp"
 
+class ThreadPool;
+
 
 struct OBJMesh {
 	std::vector<VertexIn> verts;
-	std::vector<glm::ivec3> idx; // 
+	std::vector<glm::ivec3> idx; // 三角形索引
 };
 
 
+struct OBJLoadOptions {
+	bool normalizeToUnit = true;
+	bool flipV = true;
+	bool mergeVertices = false;
+	bool smoothGeneratedNormals = false; // 缺 vn 的角点：false 时按面各自成顶点（生成的法线为面法线，硬边），true 时跨面共享顶点、生成平滑法线
+	float weldEpsilon = 0.0f; // > 0 时原始坐标下距离不超过该值的位置合并为一个（闭合模型上的裂缝、接缝两侧的重复位置）
+	ThreadPool* pool = nullptr; // 非空时大文件分块并行解析，结果与串行逐位相同
+};
+
+
+bool loadOBJ(const char* path, OBJMesh& out, const OBJLoadOptions& opt);
+
+bool loadOBJ(const char* path,
+    std::vector<VertexIn>& outVerts,
+    std::vector<glm::ivec3>& outIdx,
+    const OBJLoadOptions& opt);
+
+
 bool loadOBJ(const char* path,
     OBJMesh& out,
     bool normalizeToUnit = true,
-    bool flipV = true);
+    bool flipV = true,
+    bool mergeVertices = false);
 
 bool loadOBJ(const char* path,
     std::vector<VertexIn>& outVerts,
     std::vector<glm::ivec3>& outIdx,
     bool normalizeToUnit = true,
-    bool flipV = true);
\ No newline at end of file
+    bool flipV = true,
+    bool mergeVertices = false);
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
-// /ü/ֵ
-#include <vector>
+// 顶点/裁剪/插值相关
+#include <algorithm>
+#include <type_traits>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
@@ -10,66 +11,52 @@
 
 enum class ShadingMode { Shaded, UV, Depth };
 
+static const float kMaxScreenFx = float(1 << 26); // 超远顶点的钳制范围，保证边函数在 int64 内不溢出
+
+static inline glm::ivec2 ndcToScreenFx(const glm::vec3& ndc, int W, int H) {
+    float sx = (ndc.x * 0.5f + 0.5f) * float(W - 1) * float(kSubPixelScale);
+    float sy = (1.0f - (ndc.y * 0.5f + 0.5f)) * float(H - 1) * float(kSubPixelScale);
+    sx = clampT(sx, -kMaxScreenFx, kMaxScreenFx); sy = clampT(sy, -kMaxScreenFx, kMaxScreenFx);
+    return glm::ivec2((int)std::lround(sx), (int)std::lround(sy));
+}
+
+// 顶点阶段输出（紧凑布局，80 字节）：NDC 与是否在相机前方由 clip/invW 现算
 struct VertexOut {
     glm::vec4 clip;
-    glm::vec3 ndc;
-    glm::ivec2 screen;
+    glm::ivec2 screen; // 28.4 定点
     float depth01;
     float invW;
     glm::vec3 color;
     glm::vec2 uv;
-    glm::vec3 normal; // ռ
-    glm::vec3 world;  // ռ
-    glm::vec4 lightClip; // ռü
-    bool inFront = true;
+    glm::vec3 normal; // 世界空间，已归一化
+    glm::vec4 lightClip; // 光空间裁剪坐标
+    bool inFront() const { return clip.w > 0.0f; }
+    glm::vec2 ndcXY() const { return glm::vec2(clip) * invW; }
 };
 
 struct ShadowVOut {
     glm::vec4 clip;
-    glm::vec3 ndc;
-    glm::ivec2 screen;
+    glm::ivec2 screen; // 28.4 定点
     float depth01;
     float invW;
-    bool inFront = true;
+    bool inFront() const { return clip.w > 0.0f; }
+    glm::vec2 ndcXY() const { return glm::vec2(clip) * invW; }
 };
 
-// ׶Σ + ⣩
-static inline VertexOut vertexStage(
-    const VertexIn& vin,
-    const glm::mat4& M, const glm::mat4& MVP,
-    const glm::mat4& LVP, const glm::mat3& normalMat,
-    int screenW, int screenH)
-{
-    VertexOut vo{};
-    glm::vec4 worldPos = M * glm::vec4(vin.pos, 1.0f);
-    vo.world = glm::vec3(worldPos);
-    vo.lightClip = LVP * worldPos;
-    vo.clip = MVP * glm::vec4(vin.pos, 1.0f);
-    vo.inFront = vo.clip.w > 0.0f;
-    vo.invW = 1.0f / vo.clip.w;
-    vo.ndc = glm::vec3(vo.clip) * vo.invW;
-    float sx = (vo.ndc.x * 0.5f + 0.5f) * float(screenW - 1);
-    float sy = (1.0f - (vo.ndc.y * 0.5f + 0.5f)) * float(screenH - 1);
-    vo.screen = glm::ivec2(int(std::round(sx)), int(std::round(sy)));
-    vo.depth01 = vo.ndc.z;
-    vo.color = vin.color;
-    vo.uv = vin.uv;
-    vo.normal = glm::normalize(normalMat * vin.normal);
-    return vo;
+// 顶点阶段的每帧常量（批处理见 vertex_batch.hpp）：光空间坐标直接用 LM = LVP * M，不经过世界坐标
+struct VertexXform {
+    glm::mat4 MVP, LM;
+    glm::mat3 normalMat;
+    int W, H; // 目标缓冲尺寸
+};
+
+static inline VertexXform makeVertexXform(const glm::mat4& M, const glm::mat4& MVP, const glm::mat4& LVP, const glm::mat3& normalMat, int W, int H) {
+    return VertexXform{ MVP, LVP * M, normalMat, W, H };
 }
 
-static inline ShadowVOut vertexStageLight(const glm::vec3& posModel, const glm::mat4& M, const glm::mat4& LVP, int W, int H) {
-    ShadowVOut o{};
-    glm::vec4 worldPos = M * glm::vec4(posModel, 1.0f);
-    o.clip = LVP * worldPos;
-    o.inFront = (o.clip.w > 0.0f);
-    o.invW = 1.0f / o.clip.w;
-    o.ndc = glm::vec3(o.clip) * o.invW;
-    float sx = (o.ndc.x * 0.5f + 0.5f) * float(W - 1);
-    float sy = (1.0f - (o.ndc.y * 0.5f + 0.5f)) * float(H - 1);
-    o.screen = glm::ivec2(int(std::round(sx)), int(std::round(sy)));
-    o.depth01 = o.ndc.z;
-    return o;
+// 阴影通道只用 MVP（= LVP * M）与尺寸
+static inline VertexXform makeLightXform(const glm::mat4& M, const glm::mat4& LVP, int W, int H) {
+    return VertexXform{ LVP * M, LVP * M, glm::mat3(1.0f), W, H };
 }
 
 static inline bool isBackFaceNDC(const glm::vec2& a_ndc, const glm::vec2& b_ndc, const glm::vec2& c_ndc, bool ccwIsFront = true) {
@@ -77,43 +64,24 @@ static inline bool isBackFaceNDC(const glm::vec2& a_ndc, const glm::vec2& b_ndc,
     return ccwIsFront ? (areaN >= 0.0f) : (areaN <= 0.0f);
 }
 static inline bool isBackFaceNDC(const VertexOut& v0, const VertexOut& v1, const VertexOut& v2, bool ccwIsFront = true) {
-    return isBackFaceNDC(glm::vec2(v0.ndc), glm::vec2(v1.ndc), glm::vec2(v2.ndc), ccwIsFront);
+    return isBackFaceNDC(v0.ndcXY(), v1.ndcXY(), v2.ndcXY(), ccwIsFront);
 }
 static inline bool isBackFaceNDC(const ShadowVOut& v0, const ShadowVOut& v1, const ShadowVOut& v2, bool ccwIsFront = true) {
-    return isBackFaceNDC(glm::vec2(v0.ndc), glm::vec2(v1.ndc), glm::vec2(v2.ndc), ccwIsFront);
-}
-
-static inline void perspectiveWeights(float w0, float w1, float w2,
-    float invW0, float invW1, float invW2,
-    float& l0, float& l1, float& l2) {
-    float a0 = w0 * invW0, a1 = w1 * invW1, a2 = w2 * invW2;
-    float sum = a0 + a1 + a2;
-    if (sum != 0.0f) { l0 = a0 / sum; l1 = a1 / sum; l2 = a2 / sum; }
-    else { l0 = l1 = 0.0f; l2 = 1.0f; }
+    return isBackFaceNDC(v0.ndcXY(), v1.ndcXY(), v2.ndcXY(), ccwIsFront);
 }
 
-// ƽ棨ZOz[0,1]
-template<typename V>
-static inline bool insideNearZO(const V& v) {
-    return (v.clip.w > 0.0f) && (v.clip.z >= 0.0f);
-}
-
-// ϲֵ
+// 边上插值
 static inline VertexOut lerpVertexOut(const VertexOut& a, const VertexOut& b, float t, int W, int H) {
     VertexOut o{};
     o.clip = a.clip + t * (b.clip - a.clip);
     o.invW = 1.0f / o.clip.w;
-    o.ndc = glm::vec3(o.clip) * o.invW;
-    float sx = (o.ndc.x * 0.5f + 0.5f) * float(W - 1);
-    float sy = (1.0f - (o.ndc.y * 0.5f + 0.5f)) * float(H - 1);
-    o.screen = glm::ivec2(int(std::round(sx)), int(std::round(sy)));
-    o.depth01 = o.ndc.z;
+    glm::vec3 ndc = glm::vec3(o.clip) * o.invW;
+    o.screen = ndcToScreenFx(ndc, W, H);
+    o.depth01 = ndc.z;
     o.color = a.color + t * (b.color - a.color);
     o.uv = a.uv + t * (b.uv - a.uv);
     o.normal = glm::normalize(a.normal + t * (b.normal - a.normal));
-    o.world = a.world + t * (b.world - a.world);
     o.lightClip = a.lightClip + t * (b.lightClip - a.lightClip);
-    o.inFront = (o.clip.w > 0.0f);
     return o;
 }
 
@@ -121,56 +89,82 @@ static inline ShadowVOut lerpShadowVOut(const ShadowVOut& a, const ShadowVOut& b
     ShadowVOut o{};
     o.clip = a.clip + t * (b.clip - a.clip);
     o.invW = 1.0f / o.clip.w;
-    o.ndc = glm::vec3(o.clip) * o.invW;
-    float sx = (o.ndc.x * 0.5f + 0.5f) * float(W - 1);
-    float sy = (1.0f - (o.ndc.y * 0.5f + 0.5f)) * float(H - 1);
-    o.screen = glm::ivec2(int(std::round(sx)), int(std::round(sy)));
-    o.depth01 = o.ndc.z;
-    o.inFront = (o.clip.w > 0.0f);
+    glm::vec3 ndc = glm::vec3(o.clip) * o.invW;
+    o.screen = ndcToScreenFx(ndc, W, H);
+    o.depth01 = ndc.z;
     return o;
 }
 
-// SutherlandCHodgmanüƽ棨z>=0
-template<typename V>
-static std::vector<V> clipPolygonNearZO(const std::vector<V>& input, int W, int H) {
-    if (input.empty()) return {};
-    std::vector<V> out; out.clear();
-    V S = input.back(); bool S_in = insideNearZO(S);
-    for (const V& E : input) {
-        bool E_in = insideNearZO(E);
-        if (E_in) {
-            if (S_in) {
-                out.push_back(E);
-            }
-            else {
-                float denom = (E.clip.z - S.clip.z);
-                float t = (std::abs(denom) < 1e-8f) ? 0.0f : (0.0f - S.clip.z) / denom;
-                if constexpr (std::is_same<V, VertexOut>::value) out.push_back(lerpVertexOut(S, E, t, W, H));
-                else out.push_back(lerpShadowVOut(S, E, t, W, H));
-                out.push_back(E);
-            }
-        }
-        else if (S_in) {
-            float denom = (E.clip.z - S.clip.z);
-            float t = (std::abs(denom) < 1e-8f) ? 0.0f : (0.0f - S.clip.z) / denom;
-            if constexpr (std::is_same<V, VertexOut>::value) out.push_back(lerpVertexOut(S, E, t, W, H));
-            else out.push_back(lerpShadowVOut(S, E, t, W, H));
-        }
-        S = E; S_in = E_in;
+// 保护带（NDC 单位）：三角形只有伸出 [-G, G] 时才在 x/y 方向裁剪，屏幕内外的部分交给光栅化的包围盒/tile 裁剪。
+// 裁剪后屏幕定点坐标不超过约 G 倍屏幕尺寸，边函数保持在 SIMD 内核的 int32 范围附近
+static const float kGuardBand = 4.0f;
+static const int kClipPlaneCount = 5;                  // 近平面 + 保护带四边；远平面交给深度测试
+static const int kMaxClipVerts = 3 + kClipPlaneCount;  // 每个平面最多增加一个顶点
+
+// 顶点到裁剪平面 p 的有向距离（>= 0 为内侧）：0 近，1 左，2 右，3 下，4 上
+static inline float clipPlaneDist(const glm::vec4& c, int p) {
+    switch (p) {
+    case 0: return c.z;
+    case 1: return kGuardBand * c.w + c.x;
+    case 2: return kGuardBand * c.w - c.x;
+    case 3: return kGuardBand * c.w + c.y;
+    default: return kGuardBand * c.w - c.y;
     }
-    return out;
 }
 
-static inline int clipTriangleNearZO(const VertexOut& a, const VertexOut& b, const VertexOut& c,
-    VertexOut out[4], int W, int H) {
-    std::vector<VertexOut> poly = { a, b, c };
-    auto clipped = clipPolygonNearZO(poly, W, H);
-    int n = (int)clipped.size(); if (n > 4) n = 4; for (int i = 0; i < n; ++i) out[i] = clipped[i]; return n;
+// 需要裁剪的平面掩码（位 p 对应 clipPlaneDist 的平面 p）；三个顶点全为 0 时无需裁剪
+static inline unsigned clipPlaneMask(const glm::vec4& c) {
+    unsigned m = (c.w > 0.0f && c.z >= 0.0f) ? 0u : 1u;
+    for (int p = 1; p < kClipPlaneCount; ++p) if (clipPlaneDist(c, p) < 0.0f) m |= 1u << p;
+    return m;
+}
+
+// 视锥外码：x/y 超出 ±w、z 超出 [0, w]。三个顶点有共同位时三角形整体在视锥外
+static inline unsigned frustumOutcode(const glm::vec4& c) {
+    return (c.x < -c.w ? 1u : 0u) | (c.x > c.w ? 2u : 0u) | (c.y < -c.w ? 4u : 0u) | (c.y > c.w ? 8u : 0u) |
+        (c.z < 0.0f ? 16u : 0u) | (c.z > c.w ? 32u : 0u);
+}
+
+// 由裁剪矩阵提取与 frustumOutcode 各位对应的六个平面（n·p + d >= 0 为内侧，n 已归一化）。
+// clip 为 VP 时是世界空间平面，为 VP * M 时是模型空间平面
+static inline void extractFrustumPlanes(const glm::mat4& clip, glm::vec4 planes[6]) {
+    glm::vec4 r0(clip[0][0], clip[1][0], clip[2][0], clip[3][0]), r1(clip[0][1], clip[1][1], clip[2][1], clip[3][1]);
+    glm::vec4 r2(clip[0][2], clip[1][2], clip[2][2], clip[3][2]), r3(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+    planes[0] = r3 + r0; planes[1] = r3 - r0; planes[2] = r3 + r1; planes[3] = r3 - r1; planes[4] = r2; planes[5] = r3 - r2;
+    for (int p = 0; p < 6; ++p) planes[p] /= glm::length(glm::vec3(planes[p]));
 }
 
-static inline int clipTriangleNearZO(const ShadowVOut& a, const ShadowVOut& b, const ShadowVOut& c,
-    ShadowVOut out[4], int W, int H) {
-    std::vector<ShadowVOut> poly = { a, b, c };
-    auto clipped = clipPolygonNearZO(poly, W, H);
-    int n = (int)clipped.size(); if (n > 4) n = 4; for (int i = 0; i < n; ++i) out[i] = clipped[i]; return n;
+template<typename V>
+static inline V lerpClipVertex(const V& a, const V& b, float t, int W, int H) {
+    if constexpr (std::is_same<V, VertexOut>::value) return lerpVertexOut(a, b, t, W, H);
+    else return lerpShadowVOut(a, b, t, W, H);
+}
+
+// Sutherland–Hodgman：依次裁剪 mask 中的平面。结果为凸多边形（扇形三角化），返回顶点数（< 3 表示完全被裁掉）。
+// 不分配内存：每个平面最多增加一个顶点，out 与栈上同样大小的数组交替作为输入/输出，最后一个平面的结果正好落在 out。
+// mask 为 0（三点都在内侧）时调用方应直接引用原顶点，不必调用本函数
+template<typename V>
+static inline int clipTriangleGuardBand(const V& a, const V& b, const V& c, unsigned mask,
+    V out[kMaxClipVerts], int W, int H) {
+    V tmp[kMaxClipVerts];
+    int planes = 0;
+    for (int p = 0; p < kClipPlaneCount; ++p) planes += (mask >> p) & 1u;
+    V* src = (planes & 1) ? tmp : out; V* dst = (planes & 1) ? out : tmp;
+    src[0] = a; src[1] = b; src[2] = c;
+    int n = 3;
+    for (int p = 0; p < kClipPlaneCount; ++p) {
+        if (!(mask & (1u << p))) continue;
+        int m = 0;
+        const V* S = &src[n - 1]; float dS = clipPlaneDist(S->clip, p);
+        for (int i = 0; i < n; ++i) {
+            const V& E = src[i];
+            float dE = clipPlaneDist(E.clip, p);
+            if ((dS >= 0.0f) != (dE >= 0.0f)) dst[m++] = lerpClipVertex(*S, E, dS / (dS - dE), W, H);
+            if (dE >= 0.0f) dst[m++] = E;
+            S = &E; dS = dE;
+        }
+        if (m < 3) return 0;
+        std::swap(src, dst); n = m;
+    }
+    return n;
 }
@@ -0,0 +1,132 @@
+#pragma once
+// 压缩顶点输入：位置相对网格包围盒量化为 3×16 位，法线八面体编码为 2×16 位，uv 为半精度浮点，颜色可选（RGB8，
+// 全部顶点同色时只存一个常量）；顶点数不超过 65536 时三角形索引存为 16 位。每顶点 14 字节（带颜色 18），
+// 浮点 SoA 为 44 字节。解码在顶点阶段的取数函数中完成（见 vertex_batch.hpp）
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "mesh.hpp"
+#include "common.hpp"
+
+static const float kQuantPosMax = 65535.0f; // 位置量化的最大格点
+static const float kOctScale = 32767.0f;    // 八面体坐标的 snorm16 比例
+static const size_t kIndex16MaxVerts = 65536;
+
+// 半精度浮点（IEEE binary16）：就近偶数舍入，超出范围为无穷，保留非规格化数
+static inline std::uint16_t floatToHalf(float f) {
+    std::uint32_t x; std::memcpy(&x, &f, sizeof(x));
+    std::uint32_t sign = (x >> 16) & 0x8000u, ax = x & 0x7fffffffu;
+    if (ax >= 0x7f800000u) return (std::uint16_t)(sign | 0x7c00u | (ax > 0x7f800000u ? 0x200u : 0u));
+    if (ax >= 0x477ff000u) return (std::uint16_t)(sign | 0x7c00u); // >= 65520 舍入为无穷
+    if (ax < 0x38800000u) { // 小于 2^-14：非规格化（按 2^-24 的整数倍舍入）
+        float a; std::memcpy(&a, &ax, sizeof(a));
+        return (std::uint16_t)(sign | (std::uint32_t)std::lrint(a * 16777216.0f));
+    }
+    std::uint32_t r = ax - 0x38000000u; // 指数偏置 127 -> 15
+    r += 0x0fffu + ((r >> 13) & 1u);
+    return (std::uint16_t)(sign | (r >> 13));
+}
+
+static inline float halfToFloat(std::uint16_t h) {
+    std::uint32_t sign = (std::uint32_t)(h & 0x8000u) << 16, e = (h >> 10) & 0x1fu, m = h & 0x3ffu, x;
+    if (e == 0) { float a = (float)m * (1.0f / 16777216.0f); std::memcpy(&x, &a, sizeof(x)); x |= sign; }
+    else if (e == 31) x = sign | 0x7f800000u | (m << 13);
+    else x = sign | ((e + 112u) << 23) | (m << 13);
+    float f; std::memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+// 八面体编码：单位球投影到 |x| + |y| + |z| = 1，下半球沿对角线折到外侧，零向量编码为 +z
+static inline void octEncode(const glm::vec3& n, std::int16_t& ox, std::int16_t& oy) {
+    float s = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    float x = s > 0.0f ? n.x / s : 0.0f, y = s > 0.0f ? n.y / s : 0.0f;
+    if (n.z < 0.0f) { float tx = std::copysign(1.0f - std::fabs(y), x); y = std::copysign(1.0f - std::fabs(x), y); x = tx; }
+    ox = (std::int16_t)std::lround(clampT(x, -1.0f, 1.0f) * kOctScale);
+    oy = (std::int16_t)std::lround(clampT(y, -1.0f, 1.0f) * kOctScale);
+}
+
+// 解码出的方向未归一化（顶点阶段变换后统一归一化）；SIMD 版本按同样的运算顺序
+static inline glm::vec3 octDecode(std::int16_t ox, std::int16_t oy) {
+    float x = (float)ox * (1.0f / kOctScale), y = (float)oy * (1.0f / kOctScale);
+    float ax = std::fabs(x), ay = std::fabs(y), z = (1.0f - ax) - ay;
+    if (z < 0.0f) { x = std::copysign(1.0f - ay, x); y = std::copysign(1.0f - ax, y); }
+    return glm::vec3(x, y, z);
+}
+
+// 位置量化参数：pos = q * scale + offset，q 为 [0, 65535] 的整数（包围盒某轴厚度为 0 时该轴 scale 为 0）
+struct PosQuantization {
+    glm::vec3 offset{ 0.0f }, scale{ 0.0f };
+    std::uint16_t encode(float p, int axis) const {
+        if (!(scale[axis] > 0.0f)) return 0;
+        return (std::uint16_t)clampT(std::lround((p - offset[axis]) / scale[axis]), 0L, (long)kQuantPosMax);
+    }
+    float decode(std::uint16_t q, int axis) const { return (float)q * scale[axis] + offset[axis]; }
+};
+
+static inline PosQuantization makePosQuantization(const std::vector<VertexIn>& verts) {
+    PosQuantization pq;
+    if (verts.empty()) return pq;
+    glm::vec3 mn(verts[0].pos), mx(verts[0].pos);
+    for (const VertexIn& v : verts) { mn = glm::min(mn, v.pos); mx = glm::max(mx, v.pos); }
+    pq.offset = mn; pq.scale = (mx - mn) * (1.0f / kQuantPosMax);
+    return pq;
+}
+
+// 位置吸附到量化格点（与顶点阶段解码值逐位相同），之后建 meshlet / 包围盒用的就是实际渲染的位置
+static inline void snapPositions(std::vector<VertexIn>& verts, const PosQuantization& pq) {
+    for (VertexIn& v : verts)
+        for (int k = 0; k < 3; ++k) v.pos[k] = pq.decode(pq.encode(v.pos[k], k), k);
+}
+
+static inline std::uint32_t packRGB8(const glm::vec3& c) {
+    std::uint32_t r = 0;
+    for (int k = 0; k < 3; ++k) r |= (std::uint32_t)std::lround(clampT(c[k], 0.0f, 1.0f) * 255.0f) << (8 * k);
+    return r;
+}
+
+// 压缩格式的 SoA 顶点输入
+struct QuantizedStreams {
+    MeshArray<std::uint16_t> px, py, pz; // 量化位置
+    MeshArray<std::int16_t> ox, oy;      // 八面体法线
+    MeshArray<std::uint16_t> u, v;       // 半精度 uv
+    MeshArray<std::uint32_t> rgb;        // RGB8（R 在最低字节）；为空表示全部顶点都是 color
+    PosQuantization pos;
+    glm::vec3 color{ 1.0f };
+
+    size_t size() const { return px.size(); }
+    size_t bytes() const { return size() * 14 + rgb.size() * 4; }
+    void assign(const std::vector<VertexIn>& verts, const PosQuantization& pq) {
+        const size_t n = verts.size();
+        pos = pq;
+        px.resize(n); py.resize(n); pz.resize(n); ox.resize(n); oy.resize(n); u.resize(n); v.resize(n);
+        bool uniform = true;
+        for (size_t i = 0; i < n && uniform; ++i) uniform = std::memcmp(&verts[i].color, &verts[0].color, sizeof(glm::vec3)) == 0;
+        color = (uniform && n) ? verts[0].color : glm::vec3(1.0f);
+        rgb.clear();
+        if (!uniform) rgb.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            const VertexIn& vi = verts[i];
+            px[i] = pq.encode(vi.pos.x, 0); py[i] = pq.encode(vi.pos.y, 1); pz[i] = pq.encode(vi.pos.z, 2);
+            octEncode(vi.normal, ox[i], oy[i]);
+            u[i] = floatToHalf(vi.uv.x); v[i] = floatToHalf(vi.uv.y);
+            if (!uniform) rgb[i] = packRGB8(vi.color);
+        }
+    }
+};
+
+// 16 位三角形索引
+struct Tri16 {
+    std::uint16_t v[3];
+};
+
+static inline glm::ivec3 expandTri(const Tri16& t) { return glm::ivec3(t.v[0], t.v[1], t.v[2]); }
+static inline glm::ivec3 expandTri(const glm::ivec3& t) { return t; }
+
+static inline void packIndices16(const std::vector<glm::ivec3>& idx, std::vector<Tri16>& out) {
+    out.resize(idx.size());
+    for (size_t t = 0; t < idx.size(); ++t)
+        for (int k = 0; k < 3; ++k) out[t].v[k] = (std::uint16_t)idx[t][k];
+}
@@ -1,7 +1,8 @@
 #pragma once
-// Ӱͼͨդ
+// 阴影贴图与主通道栅格化
 #include <glm/glm.hpp>
 #include "pipeline.hpp"
+#include "raster_row.hpp"
 #include "texture.hpp"
 #include "buffers.hpp"
 #include "common.hpp"
@@ -24,38 +25,340 @@ static inline float shadowPCF(const DepthBuffer& sm, float u, float v, float dep
     return (count > 0) ? (lit / (float)count) : 1.0f;
 }
 
+// 三角形级剔除（光栅与分块共用）。视锥外剔除与裁剪在分块阶段完成，与屏幕是否相交由包围盒判断，
+// 这里只要求顶点都在相机前方（未经裁剪直接光栅化时的保护）
+static inline bool acceptTriangleDepth(const ShadowVOut& V0, const ShadowVOut& V1, const ShadowVOut& V2, bool cullFrontFaces) {
+    if (!(V0.inFront() && V1.inFront() && V2.inFront())) return false;
+    bool back = isBackFaceNDC(V0, V1, V2, true);
+    return cullFrontFaces ? back : !back;
+}
+
+static inline bool acceptTriangleTex(const VertexOut& V0, const VertexOut& V1, const VertexOut& V2, bool enableCull) {
+    if (!(V0.inFront() && V1.inFront() && V2.inFront())) return false;
+    return !(enableCull && isBackFaceNDC(V0, V1, V2, true));
+}
+
+// 边函数在像素 (x, y) 处的值（e 以 (minX, minY) 为起点）
+static inline std::int64_t edgeAt(const EdgeFx& e, int minX, int minY, int x, int y) {
+    return e.row + (std::int64_t)(x - minX) * e.stepX + (std::int64_t)(y - minY) * e.stepY;
+}
+
+// 屏幕空间线性量 f = c + dx * (x - ox) + dy * (y - oy)，在像素中心求值
+struct AttrPlane {
+    float c, dx, dy;
+};
+
+// fx = x - ox, fy = y - oy；行内核按同样的运算顺序求深度
+static inline float evalPlane(const AttrPlane& p, float fx, float fy) {
+    return (p.c + p.dy * fy) + p.dx * fx;
+}
+
+// 三角形建立：重心坐标 b1、b2 在原点处的值与屏幕梯度（b0 = 1 - b1 - b2）。
+// 原点取包围盒左上角钳制到屏幕内，与 tile 无关，因此分块光栅化与可见性缓冲解析得到逐位相同的平面
+struct PlaneSetup {
+    int ox, oy;
+    float b1, b2, b1dx, b1dy, b2dx, b2dy;
+    // 顶点值 f0/f1/f2 的线性插值平面
+    AttrPlane plane(float f0, float f1, float f2) const {
+        float d1 = f1 - f0, d2 = f2 - f0;
+        return AttrPlane{ f0 + d1 * b1 + d2 * b2, d1 * b1dx + d2 * b2dx, d1 * b1dy + d2 * b2dy };
+    }
+};
+
+// e 以 (ex, ey) 为起点，area > 0；W/H 为目标缓冲尺寸
+static inline PlaneSetup setupPlanes(const EdgeFx* e, int ex, int ey, std::int64_t area,
+    const glm::ivec2& p0, const glm::ivec2& p1, const glm::ivec2& p2, int W, int H) {
+    PlaneSetup ps;
+    ps.ox = clampT(fxFirstPixel(std::min(p0.x, std::min(p1.x, p2.x))), 0, W - 1);
+    ps.oy = clampT(fxFirstPixel(std::min(p0.y, std::min(p1.y, p2.y))), 0, H - 1);
+    float invArea = 1.0f / (float)area;
+    ps.b1 = float(edgeAt(e[1], ex, ey, ps.ox, ps.oy) - e[1].bias) * invArea;
+    ps.b2 = float(edgeAt(e[2], ex, ey, ps.ox, ps.oy) - e[2].bias) * invArea;
+    ps.b1dx = float(e[1].stepX) * invArea; ps.b1dy = float(e[1].stepY) * invArea;
+    ps.b2dx = float(e[2].stepX) * invArea; ps.b2dy = float(e[2].stepY) * invArea;
+    return ps;
+}
+
+// 深度平面与钳制范围（三角形顶点深度范围）
+template<typename V>
+static inline void setupDepthPlane(AttrPlane& zPlane, float& zLo, float& zHi, const PlaneSetup& ps, const V& v0, const V& v1, const V& v2) {
+    zPlane = ps.plane(v0.depth01, v1.depth01, v2.depth01);
+    zLo = std::min(v0.depth01, std::min(v1.depth01, v2.depth01));
+    zHi = std::max(v0.depth01, std::max(v1.depth01, v2.depth01));
+}
+
+// 行内核的三角形常量；包围盒超出 int32 安全范围时退回标量内核。深度 (z/w) 在屏幕空间线性，直接用平面
+template<typename V>
+static inline RasterRowFn setupRasterRow(RasterRowIn& in, AttrPlane& zPlane, const EdgeFx* e, const PlaneSetup& ps,
+    const V& v0, const V& v1, const V& v2, int spanX, int spanY) {
+    for (int k = 0; k < 3; ++k) in.stepX[k] = e[k].stepX;
+    setupDepthPlane(zPlane, in.zLo, in.zHi, ps, v0, v1, v2);
+    in.ox = ps.ox; in.dzdx = zPlane.dx;
+    return edgesFitInt32(e, spanX, spanY) ? rasterRowFnFor(rasterSimdLevel()) : rasterRowScalar;
+}
+
+// 小三角形路径：mask 为 coverageMaskSmall 的结果，逐像素求深度并测试（运算与行内核相同，结果一致），
+// 通过的像素调用 f(x, y, z)。不走 HiZ 块遍历与行内核，写过的块置脏
+template<typename F>
+static inline void rasterSmallTriangle(DepthBuffer& db, std::uint32_t mask, const AttrPlane& zPlane, const PlaneSetup& ps,
+    float zLo, float zHi, int minX, int minY, int maxX, F f) {
+    for (int y = minY, bit = 0; (mask >> bit) != 0; ++y) {
+        float zRow = zPlane.c + zPlane.dy * float(y - ps.oy);
+        float* zrow = &db.z[(size_t)y * db.w];
+        for (int x = minX; x <= maxX; ++x, ++bit) {
+            if (!((mask >> bit) & 1u)) continue;
+            float z = zRow + float(x - ps.ox) * zPlane.dx;
+            z = std::min(std::max(z, zLo), zHi);
+            if (z < zrow[x]) { zrow[x] = z; db.markDirty(x / kHiZBlock, y / kHiZBlock); f(x, y, z); }
+        }
+    }
+}
+
+// 行段起点：边函数与本行深度
+static inline void beginRasterRow(RasterRowIn& in, const AttrPlane& zPlane, const EdgeFx* e, int minX, int minY,
+    const PlaneSetup& ps, int xs, int y) {
+    for (int k = 0; k < 3; ++k) in.E[k] = edgeAt(e[k], minX, minY, xs, y);
+    in.zRow = zPlane.c + zPlane.dy * float(y - ps.oy);
+}
+
+// 内核把深度钳制在顶点深度范围内，HiZ 判定是精确的；余量只为保险
+static const float kHiZEpsilon = 1e-6f;
+// 包围盒小于此像素数的三角形不触发脏块重算（重算 8x8 块的代价与光栅化它相当）
+static const int kHiZRefreshArea = 256;
+
+// 以 8x8 块遍历包围盒：HiZ 判定整块被遮挡的块直接跳过，其余相邻块合并成行段交给 span(y, xs, xe)，
+// span 返回写入深度的像素数。结束后更新被写块的深度范围：三角形盖满整块且整体在前时直接更新，否则置脏。
+template<typename SpanFn>
+static inline void rasterBlocksHiZ(DepthBuffer& db, const EdgeFx* e, int minX, int minY, int maxX, int maxY,
+    float triMinZ, float triMaxZ, SpanFn span) {
+    const int B = kHiZBlock, NB = kRowSpan / kHiZBlock;
+    const float rejectZ = triMinZ - kHiZEpsilon;
+    const bool refresh = (maxX - minX + 1) * (maxY - minY + 1) >= kHiZRefreshArea;
+    for (int by = minY / B; by <= maxY / B; ++by) {
+        int y0 = std::max(minY, by * B), y1 = std::min(maxY, by * B + B - 1);
+        for (int xc = (minX / kRowSpan) * kRowSpan; xc <= maxX; xc += kRowSpan) {
+            int bx0 = std::max(minX, xc) / B, bx1 = std::min(maxX, xc + kRowSpan - 1) / B;
+            bool live[NB], hit[NB]; bool any = false;
+            for (int bx = bx0; bx <= bx1; ++bx) { live[bx - bx0] = !db.blockOccludes(bx, by, rejectZ, refresh); hit[bx - bx0] = false; any |= live[bx - bx0]; }
+            if (!any) continue;
+
+            for (int y = y0; y <= y1; ++y) {
+                for (int bx = bx0; bx <= bx1;) {
+                    if (!live[bx - bx0]) { ++bx; continue; }
+                    int bs = bx; while (bx <= bx1 && live[bx - bx0]) ++bx;
+                    if (span(y, std::max(minX, bs * B), std::min(maxX, bx * B - 1)) > 0)
+                        for (int k = bs; k < bx; ++k) hit[k - bx0] = true;
+                }
+            }
+
+            for (int bx = bx0; bx <= bx1; ++bx) {
+                if (!hit[bx - bx0]) continue;
+                int b = by * db.bw + bx;
+                int x0 = bx * B, x1 = std::min(db.w, x0 + B) - 1, yb0 = by * B, yb1 = std::min(db.h, yb0 + B) - 1;
+                bool full = !db.dirty[b] && triMaxZ + kHiZEpsilon < db.zMin[b] &&
+                    x0 >= minX && x1 <= maxX && yb0 >= minY && yb1 <= maxY;
+                for (int k = 0; k < 3 && full; ++k)
+                    full = (edgeAt(e[k], minX, minY, x0, yb0) | edgeAt(e[k], minX, minY, x1, yb0) |
+                            edgeAt(e[k], minX, minY, x0, yb1) | edgeAt(e[k], minX, minY, x1, yb1)) >= 0;
+                if (full) { db.zMin[b] = triMinZ - kHiZEpsilon; db.zMax[b] = triMaxZ + kHiZEpsilon; } // 整块被本三角形覆盖
+                else db.dirty[b] = 1;
+            }
+        }
+    }
+}
+
+// 透视校正插值的平面：1/w 与 属性/w 都在屏幕空间线性，像素处 属性 = 平面值 / (1/w 平面值)
+struct ShadePlanes {
+    AttrPlane q; float qLo, qHi; // 1/w 及其顶点范围（钳制防止细长三角形的舍入越界）
+    AttrPlane uv[2], color[3], normal[3], lightClip[4];
+};
+
+// 只建立该渲染状态会用到的属性平面
+template<ShadingMode Mode, bool Shadows, bool Lighting>
+static inline void setupShadePlanes(ShadePlanes& sp, const PlaneSetup& ps, const VertexOut& v0, const VertexOut& v1, const VertexOut& v2) {
+    if constexpr (Mode != ShadingMode::Depth) {
+        float q0 = v0.invW, q1 = v1.invW, q2 = v2.invW;
+        sp.q = ps.plane(q0, q1, q2);
+        sp.qLo = std::min(q0, std::min(q1, q2)); sp.qHi = std::max(q0, std::max(q1, q2));
+        for (int k = 0; k < 2; ++k) sp.uv[k] = ps.plane(v0.uv[k] * q0, v1.uv[k] * q1, v2.uv[k] * q2);
+        if constexpr (Mode == ShadingMode::Shaded) {
+            for (int k = 0; k < 3; ++k) sp.color[k] = ps.plane(v0.color[k] * q0, v1.color[k] * q1, v2.color[k] * q2);
+            if constexpr (Lighting) {
+                for (int k = 0; k < 3; ++k) sp.normal[k] = ps.plane(v0.normal[k] * q0, v1.normal[k] * q1, v2.normal[k] * q2);
+                if constexpr (Shadows)
+                    for (int k = 0; k < 4; ++k) sp.lightClip[k] = ps.plane(v0.lightClip[k] * q0, v1.lightClip[k] * q1, v2.lightClip[k] * q2);
+            }
+        }
+    }
+}
+
+// 片元着色：(fx, fy) 为相对平面原点的像素坐标，z 为已插值的深度；Ldir 为归一化光照方向。
+// 渲染状态是模板参数，每种组合一份实例：像素循环内没有状态分支，用不到的属性不插值
+template<ShadingMode Mode, bool Bilinear, bool Shadows, bool Lighting>
+static inline std::uint32_t shadeFragmentT(const ShadePlanes& sp, float fx, float fy, float z,
+    const Texture2D& tex, const DepthBuffer& shadowMap,
+    const glm::vec3& Ldir, const glm::vec3& ambient, const glm::vec3& lightColor) {
+    if constexpr (Mode == ShadingMode::Depth) {
+        float d = 1.0f - glm::clamp(z, 0.0f, 1.0f); // 近白远黑（可反转）
+        return packARGB8(glm::vec3(d));
+    }
+    else {
+        float w = 1.0f / clampT(evalPlane(sp.q, fx, fy), sp.qLo, sp.qHi);
+        glm::vec2 uv(evalPlane(sp.uv[0], fx, fy) * w, evalPlane(sp.uv[1], fx, fy) * w);
+        if constexpr (Mode == ShadingMode::UV) {
+            return packARGB8(glm::vec3(Texture2D::wrap01(uv.x), Texture2D::wrap01(uv.y), 0.0f));
+        }
+        else { // Shaded
+            glm::vec3 colVtx(evalPlane(sp.color[0], fx, fy) * w, evalPlane(sp.color[1], fx, fy) * w, evalPlane(sp.color[2], fx, fy) * w);
+            glm::vec3 texel = Bilinear ? tex.sampleBilinear(uv.x, uv.y) : tex.sampleNearest(uv.x, uv.y);
+            if constexpr (!Lighting) {
+                return packARGB8(texel * colVtx);
+            }
+            else {
+                // 归一化会消去 w，法线直接用 法线/w 平面
+                glm::vec3 normalW = glm::normalize(glm::vec3(evalPlane(sp.normal[0], fx, fy), evalPlane(sp.normal[1], fx, fy), evalPlane(sp.normal[2], fx, fy)));
+                float NdotL = std::max(0.0f, glm::dot(normalW, Ldir));
+                float s = 1.0f;
+                if constexpr (Shadows) {
+                    // 光空间：透视除法同样消去 w
+                    glm::vec4 lclip(evalPlane(sp.lightClip[0], fx, fy), evalPlane(sp.lightClip[1], fx, fy), evalPlane(sp.lightClip[2], fx, fy), evalPlane(sp.lightClip[3], fx, fy));
+                    glm::vec3 lndc = glm::vec3(lclip) / lclip.w;
+                    float u = lndc.x * 0.5f + 0.5f;
+                    float v = 1.0f - (lndc.y * 0.5f + 0.5f);
+                    float bias = std::max(0.001f, 0.0025f * (1.0f - NdotL));
+                    s = shadowPCF(shadowMap, u, v, lndc.z, bias, 1);
+                }
+                return packARGB8(texel * colVtx * (ambient + lightColor * (NdotL * s)));
+            }
+        }
+    }
+}
+
+// 渲染状态 -> 特化实例 K<...>::run。UV/Depth 模式与采样、阴影、光照开关无关，只各保留一份实例
+template<template<ShadingMode, bool, bool, bool> class K>
+static inline typename K<ShadingMode::Shaded, true, true, true>::Fn selectShadeKernel(ShadingMode mode, bool bilinear, bool shadows, bool lighting) {
+    typedef typename K<ShadingMode::Shaded, true, true, true>::Fn Fn;
+    static const Fn shaded[2][2][2] = { // [bilinear][shadows][lighting]
+        { { K<ShadingMode::Shaded, false, false, false>::run, K<ShadingMode::Shaded, false, false, true>::run },
+          { K<ShadingMode::Shaded, false, true, false>::run, K<ShadingMode::Shaded, false, true, true>::run } },
+        { { K<ShadingMode::Shaded, true, false, false>::run, K<ShadingMode::Shaded, true, false, true>::run },
+          { K<ShadingMode::Shaded, true, true, false>::run, K<ShadingMode::Shaded, true, true, true>::run } } };
+    if (mode == ShadingMode::UV) return K<ShadingMode::UV, false, false, false>::run;
+    if (mode == ShadingMode::Depth) return K<ShadingMode::Depth, false, false, false>::run;
+    return shaded[bilinear][shadows][lighting];
+}
+
+// clip：只写入该矩形内的像素（分块光栅化时为 tile 范围）
+static inline void rasterTriangleDepth(const ShadowVOut& V0, const ShadowVOut& V1, const ShadowVOut& V2,
+    DepthBuffer& db, bool cullFrontFaces, const RectI& clip) {
+    if (!acceptTriangleDepth(V0, V1, V2, cullFrontFaces)) return;
+
+    const ShadowVOut* v0 = &V0; const ShadowVOut* v1 = &V1; const ShadowVOut* v2 = &V2;
+    glm::ivec2 p0 = v0->screen, p1 = v1->screen, p2 = v2->screen;
+    std::int64_t area = edgeFunctionFx(p0, p1, p2); if (area == 0) return; if (area < 0) { std::swap(v1, v2); std::swap(p1, p2); area = -area; }
+
+    int minX = std::max(clip.x0, fxFirstPixel(std::min(p0.x, std::min(p1.x, p2.x))));
+    int maxX = std::min(clip.x1, fxLastPixel(std::max(p0.x, std::max(p1.x, p2.x))));
+    int minY = std::max(clip.y0, fxFirstPixel(std::min(p0.y, std::min(p1.y, p2.y))));
+    int maxY = std::min(clip.y1, fxLastPixel(std::max(p0.y, std::max(p1.y, p2.y))));
+    if (minX > maxX || minY > maxY) return;
+
+    EdgeFx e[3] = { setupEdgeFx(p1, p2, minX, minY), setupEdgeFx(p2, p0, minX, minY), setupEdgeFx(p0, p1, minX, minY) };
+    if ((maxX - minX + 1) * (maxY - minY + 1) <= kSmallTriPixels) {
+        std::uint32_t mask = coverageMaskSmall(e, minX, minY, maxX, maxY);
+        if (!mask) return; // 不覆盖任何像素中心
+        PlaneSetup ps = setupPlanes(e, minX, minY, area, p0, p1, p2, db.w, db.h);
+        AttrPlane zPlane; float zLo, zHi; setupDepthPlane(zPlane, zLo, zHi, ps, *v0, *v1, *v2);
+        rasterSmallTriangle(db, mask, zPlane, ps, zLo, zHi, minX, minY, maxX, [](int, int, float) {});
+        return;
+    }
+    PlaneSetup ps = setupPlanes(e, minX, minY, area, p0, p1, p2, db.w, db.h);
+    RasterRowIn in; AttrPlane zPlane;
+    RasterRowFn rowFn = setupRasterRow(in, zPlane, e, ps, *v0, *v1, *v2, maxX - minX, maxY - minY);
+
+    rasterBlocksHiZ(db, e, minX, minY, maxX, maxY, in.zLo, in.zHi, [&](int y, int xs, int xe) {
+        beginRasterRow(in, zPlane, e, minX, minY, ps, xs, y);
+        return rowFn(in, xs, xe, &db.z[(size_t)y * db.w], nullptr);
+        });
+}
+
 static inline void rasterTriangleDepth(const ShadowVOut& V0, const ShadowVOut& V1, const ShadowVOut& V2,
     DepthBuffer& db, bool cullFrontFaces) {
-    auto inNDC = [](const ShadowVOut& v) {
-        return v.inFront && v.ndc.x >= -1 && v.ndc.x <= 1 && v.ndc.y >= -1 && v.ndc.y <= 1 && v.ndc.z >= 0 && v.ndc.z <= 1;
-        };
-    if (!inNDC(V0) && !inNDC(V1) && !inNDC(V2)) return;
+    rasterTriangleDepth(V0, V1, V2, db, cullFrontFaces, RectI{ 0, 0, db.w - 1, db.h - 1 });
+}
 
-    bool back = isBackFaceNDC(V0, V1, V2, true);
-    if (cullFrontFaces) { if (!back) return; }
-    else { if (back) return; }
-
-    ShadowVOut v0 = V0, v1 = V1, v2 = V2;
-    glm::vec2 p0(v0.screen), p1(v1.screen), p2(v2.screen);
-    float area = edgeFunction(p0, p1, p2); if (area == 0.0f) return; if (area < 0.0f) { std::swap(v1, v2); std::swap(p1, p2); area = -area; }
-
-    int minX = std::max(0, std::min(v0.screen.x, std::min(v1.screen.x, v2.screen.x)));
-    int maxX = std::min(db.w - 1, std::max(v0.screen.x, std::max(v1.screen.x, v2.screen.x)));
-    int minY = std::max(0, std::min(v0.screen.y, std::min(v1.screen.y, v2.screen.y)));
-    int maxY = std::min(db.h - 1, std::max(v0.screen.y, std::max(v1.screen.y, v2.screen.y)));
-
-    for (int y = minY; y <= maxY; ++y) {
-        for (int x = minX; x <= maxX; ++x) {
-            glm::vec2 p(float(x) + 0.5f, float(y) + 0.5f);
-            float w0 = edgeFunction(p1, p2, p), w1 = edgeFunction(p2, p0, p), w2 = edgeFunction(p0, p1, p);
-            if (w0 >= 0 && w1 >= 0 && w2 >= 0) {
-                w0 /= area; w1 /= area; w2 /= area;
-                float l0, l1, l2; perspectiveWeights(w0, w1, w2, v0.invW, v1.invW, v2.invW, l0, l1, l2);
-                float z = l0 * v0.depth01 + l1 * v1.depth01 + l2 * v2.depth01;
-                float& zref = db.at(x, y); if (z < zref) zref = z;
-            }
+// 主通道三角形：Ldir 为归一化光照方向，clip 同上
+typedef void (*RasterTexFn)(const VertexOut& V0, const VertexOut& V1, const VertexOut& V2,
+    const Texture2D& tex, Framebuffer& fb, DepthBuffer& db, const DepthBuffer& shadowMap, bool enableCull,
+    const glm::vec3& Ldir, const glm::vec3& ambient, const glm::vec3& lightColor, const RectI& clip);
+
+template<ShadingMode Mode, bool Bilinear, bool Shadows, bool Lighting>
+struct RasterTexKernel {
+    typedef RasterTexFn Fn;
+    static void run(const VertexOut& V0, const VertexOut& V1, const VertexOut& V2,
+        const Texture2D& tex, Framebuffer& fb, DepthBuffer& db, const DepthBuffer& shadowMap, bool enableCull,
+        const glm::vec3& Ldir, const glm::vec3& ambient, const glm::vec3& lightColor, const RectI& clip) {
+        if (!acceptTriangleTex(V0, V1, V2, enableCull)) return;
+
+        const VertexOut* v0 = &V0; const VertexOut* v1 = &V1; const VertexOut* v2 = &V2;
+        glm::ivec2 p0 = v0->screen, p1 = v1->screen, p2 = v2->screen;
+        std::int64_t area = edgeFunctionFx(p0, p1, p2); if (area == 0) return; if (area < 0) { std::swap(v1, v2); std::swap(p1, p2); area = -area; }
+
+        int minX = std::max(clip.x0, fxFirstPixel(std::min(p0.x, std::min(p1.x, p2.x))));
+        int maxX = std::min(clip.x1, fxLastPixel(std::max(p0.x, std::max(p1.x, p2.x))));
+        int minY = std::max(clip.y0, fxFirstPixel(std::min(p0.y, std::min(p1.y, p2.y))));
+        int maxY = std::min(clip.y1, fxLastPixel(std::max(p0.y, std::max(p1.y, p2.y))));
+        if (minX > maxX || minY > maxY) return;
+
+        EdgeFx e[3] = { setupEdgeFx(p1, p2, minX, minY), setupEdgeFx(p2, p0, minX, minY), setupEdgeFx(p0, p1, minX, minY) };
+        if ((maxX - minX + 1) * (maxY - minY + 1) <= kSmallTriPixels) {
+            std::uint32_t mask = coverageMaskSmall(e, minX, minY, maxX, maxY);
+            if (!mask) return; // 不覆盖任何像素中心
+            PlaneSetup ps = setupPlanes(e, minX, minY, area, p0, p1, p2, db.w, db.h);
+            AttrPlane zPlane; float zLo, zHi; setupDepthPlane(zPlane, zLo, zHi, ps, *v0, *v1, *v2);
+            ShadePlanes sp; bool shadeReady = false; // 全部被遮挡时不建立属性平面
+            rasterSmallTriangle(db, mask, zPlane, ps, zLo, zHi, minX, minY, maxX, [&](int x, int y, float z) {
+                if (!shadeReady) { setupShadePlanes<Mode, Shadows, Lighting>(sp, ps, *v0, *v1, *v2); shadeReady = true; }
+                fb.pixels[(size_t)y * fb.w + x] = shadeFragmentT<Mode, Bilinear, Shadows, Lighting>(sp, float(x - ps.ox), float(y - ps.oy), z, tex, shadowMap, Ldir, ambient, lightColor);
+                });
+            return;
         }
+        PlaneSetup ps = setupPlanes(e, minX, minY, area, p0, p1, p2, db.w, db.h);
+        RasterRowIn in; AttrPlane zPlane;
+        RasterRowFn rowFn = setupRasterRow(in, zPlane, e, ps, *v0, *v1, *v2, maxX - minX, maxY - minY);
+        ShadePlanes sp; setupShadePlanes<Mode, Shadows, Lighting>(sp, ps, *v0, *v1, *v2);
+        RasterRowOut passed;
+
+        rasterBlocksHiZ(db, e, minX, minY, maxX, maxY, in.zLo, in.zHi, [&](int y, int xs, int xe) {
+            beginRasterRow(in, zPlane, e, minX, minY, ps, xs, y);
+            // 内核已完成覆盖与深度测试并写入深度，这里只对通过的像素着色
+            int n = rowFn(in, xs, xe, &db.z[(size_t)y * db.w], &passed);
+            std::uint32_t* row = &fb.pixels[(size_t)y * fb.w];
+            float fy = float(y - ps.oy);
+            for (int i = 0; i < n; ++i)
+                row[passed.x[i]] = shadeFragmentT<Mode, Bilinear, Shadows, Lighting>(sp, float(passed.x[i] - ps.ox), fy, passed.z[i], tex, shadowMap, Ldir, ambient, lightColor);
+            return n;
+            });
     }
+};
+
+// 每次绘制（或每帧）选一次，逐三角形直接调用
+static inline RasterTexFn rasterTexFnFor(ShadingMode mode, bool bilinear, bool enableShadows, bool enableLighting) {
+    return selectShadeKernel<RasterTexKernel>(mode, bilinear, enableShadows, enableLighting);
+}
+
+static inline void rasterTriangleTexShadow(
+    const VertexOut& V0, const VertexOut& V1, const VertexOut& V2,
+    const Texture2D& tex, Framebuffer& fb, DepthBuffer& db,
+    const DepthBuffer& shadowMap,
+    ShadingMode mode,
+    bool enableCull, bool bilinear,
+    bool enableShadows, bool enableLighting,
+    const glm::vec3& lightDirWS, const glm::vec3& ambient, const glm::vec3& lightColor,
+    const RectI& clip)
+{
+    rasterTexFnFor(mode, bilinear, enableShadows, enableLighting)(V0, V1, V2, tex, fb, db, shadowMap, enableCull,
+        glm::normalize(lightDirWS), ambient, lightColor, clip);
 }
 
 static inline void rasterTriangleTexShadow(
@@ -67,69 +370,6 @@ static inline void rasterTriangleTexShadow(
     bool enableShadows, bool enableLighting,
     const glm::vec3& lightDirWS, const glm::vec3& ambient, const glm::vec3& lightColor)
 {
-    auto inNDC = [](const VertexOut& v) {
-        return v.inFront && v.ndc.x >= -1 && v.ndc.x <= 1 && v.ndc.y >= -1 && v.ndc.y <= 1 && v.ndc.z >= 0 && v.ndc.z <= 1;
-        };
-    if (!inNDC(V0) && !inNDC(V1) && !inNDC(V2)) return;
-
-    if (enableCull && isBackFaceNDC(V0, V1, V2, true)) return;
-
-    VertexOut v0 = V0, v1 = V1, v2 = V2;
-    glm::vec2 p0(v0.screen), p1(v1.screen), p2(v2.screen);
-    float area = edgeFunction(p0, p1, p2); if (area == 0.0f) return; if (area < 0.0f) { std::swap(v1, v2); std::swap(p1, p2); area = -area; }
-
-    int minX = std::max(0, std::min(v0.screen.x, std::min(v1.screen.x, v2.screen.x)));
-    int maxX = std::min(fb.w - 1, std::max(v0.screen.x, std::max(v1.screen.x, v2.screen.x)));
-    int minY = std::max(0, std::min(v0.screen.y, std::min(v1.screen.y, v2.screen.y)));
-    int maxY = std::min(fb.h - 1, std::max(v0.screen.y, std::max(v1.screen.y, v2.screen.y)));
-
-    glm::vec3 Ldir = glm::normalize(lightDirWS);
-
-    for (int y = minY; y <= maxY; ++y) {
-        for (int x = minX; x <= maxX; ++x) {
-            glm::vec2 p(float(x) + 0.5f, float(y) + 0.5f);
-            float w0 = edgeFunction(p1, p2, p), w1 = edgeFunction(p2, p0, p), w2 = edgeFunction(p0, p1, p);
-            if (w0 >= 0 && w1 >= 0 && w2 >= 0) {
-                w0 /= area; w1 /= area; w2 /= area;
-                float l0, l1, l2; perspectiveWeights(w0, w1, w2, v0.invW, v1.invW, v2.invW, l0, l1, l2);
-
-                float z = l0 * v0.depth01 + l1 * v1.depth01 + l2 * v2.depth01;
-                float& zref = db.at(x, y);
-                if (z < zref) {
-                    zref = z;
-
-                    glm::vec2 uv = l0 * v0.uv + l1 * v1.uv + l2 * v2.uv;
-                    glm::vec3 colVtx = l0 * v0.color + l1 * v1.color + l2 * v2.color;
-                    glm::vec3 normalW = glm::normalize(l0 * v0.normal + l1 * v1.normal + l2 * v2.normal);
-
-                    // ռ
-                    glm::vec4 lclip = l0 * v0.lightClip + l1 * v1.lightClip + l2 * v2.lightClip;
-                    glm::vec3 lndc = glm::vec3(lclip) / lclip.w;
-                    float u = lndc.x * 0.5f + 0.5f;
-                    float v = 1.0f - (lndc.y * 0.5f + 0.5f);
-                    float depthL = lndc.z;
-
-                    // ģʽɫ
-                    glm::vec3 outColor(0.0f);
-                    if (mode == ShadingMode::UV) {
-                        outColor = glm::vec3(Texture2D::wrap01(uv.x), Texture2D::wrap01(uv.y), 0.0f);
-                    }
-                    else if (mode == ShadingMode::Depth) {
-                        float d = 1.0f - glm::clamp(z, 0.0f, 1.0f); // Զڣɷת
-                        outColor = glm::vec3(d);
-                    }
-                    else { // Shaded
-                        float NdL = std::max(0.0f, glm::dot(normalW, Ldir));
-                        float bias = std::max(0.001f, 0.0025f * (1.0f - NdL));
-                        float s = 1.0f; if (enableShadows) s = shadowPCF(shadowMap, u, v, depthL, bias, 1);
-                        glm::vec3 texel = tex.sample(uv.x, uv.y, bilinear);
-                        float NdotL = std::max(0.0f, glm::dot(normalW, Ldir));
-                        glm::vec3 lit = enableLighting ? (ambient + lightColor * (NdotL * s)) : glm::vec3(1.0f);
-                        outColor = texel * colVtx * lit;
-                    }
-                    fb.putPixel(x, y, packARGB8(outColor));
-                }
-            }
-        }
-    }
+    rasterTriangleTexShadow(V0, V1, V2, tex, fb, db, shadowMap, mode, enableCull, bilinear, enableShadows, enableLighting,
+        lightDirWS, ambient, lightColor, RectI{ 0, 0, fb.w - 1, fb.h - 1 });
 }
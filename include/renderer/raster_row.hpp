@@ -0,0 +1,145 @@
+#pragma once
+// 行段像素批处理内核：覆盖测试 + 深度平面求值 + 深度比较/写入（标量 / SSE4.1 / AVX2）
+// 各版本运算顺序完全一致，输出逐位相同；SIMD 版要求边函数在 int32 内（见 edgesFitInt32）
+#include <cstdint>
+#include <algorithm>
+#include "simd.hpp"
+#include "common.hpp"
+
+static const int kRowSpan = 64; // 光栅循环按此长度切分行段
+
+// 三角形在行段上的状态：覆盖用定点边函数，深度为屏幕空间平面 z = zRow + dzdx * (x - ox)
+struct RasterRowIn {
+    std::int64_t E[3];     // x0 处的边函数值（已含 bias）
+    std::int64_t stepX[3];
+    int ox;                // 深度平面原点 x
+    float zRow, dzdx;      // zRow 为本行在 ox 处的深度
+    float zLo, zHi;        // 三角形顶点深度范围：插值结果钳制在内，防止细长三角形的舍入越界
+};
+
+// 深度测试通过的像素：x 及其深度
+struct RasterRowOut {
+    int x[kRowSpan];
+    float z[kRowSpan];
+};
+
+// 处理 [x0, x1]（长度 <= kRowSpan），zrow 为该行深度；out 为空时只写深度。返回通过深度测试的像素数
+typedef int (*RasterRowFn)(const RasterRowIn& in, int x0, int x1, float* zrow, RasterRowOut* out);
+
+// 从 xStart 处的状态推进到 x0 后逐像素处理，结果追加在 out 的第 n 项之后
+static inline int rasterRowScalarAt(const RasterRowIn& in, int xStart, int x0, int x1, float* zrow, RasterRowOut* out, int n) {
+    std::int64_t E0 = in.E[0] + (x0 - xStart) * in.stepX[0];
+    std::int64_t E1 = in.E[1] + (x0 - xStart) * in.stepX[1];
+    std::int64_t E2 = in.E[2] + (x0 - xStart) * in.stepX[2];
+    for (int x = x0; x <= x1; ++x, E0 += in.stepX[0], E1 += in.stepX[1], E2 += in.stepX[2]) {
+        if ((E0 | E1 | E2) < 0) continue;
+        float z = in.zRow + float(x - in.ox) * in.dzdx;
+        z = std::min(std::max(z, in.zLo), in.zHi);
+        if (z < zrow[x]) {
+            zrow[x] = z;
+            if (out) { out->x[n] = x; out->z[n] = z; }
+            ++n;
+        }
+    }
+    return n;
+}
+
+static inline int rasterRowScalar(const RasterRowIn& in, int x0, int x1, float* zrow, RasterRowOut* out) {
+    return rasterRowScalarAt(in, x0, x0, x1, zrow, out, 0);
+}
+
+// 边函数在包围盒四角取极值（线性），全部落在 ±2^30 内时 SIMD 的 int32 通道不会溢出
+static inline bool edgesFitInt32(const EdgeFx* e, int spanX, int spanY) {
+    const std::int64_t lim = std::int64_t(1) << 30;
+    for (int k = 0; k < 3; ++k) {
+        if (e[k].stepX * 8 >= lim || e[k].stepX * 8 <= -lim) return false;
+        std::int64_t c[4] = { e[k].row, e[k].row + spanX * e[k].stepX, e[k].row + spanY * e[k].stepY, e[k].row + spanX * e[k].stepX + spanY * e[k].stepY };
+        for (std::int64_t v : c) if (v >= lim || v <= -lim) return false;
+    }
+    return true;
+}
+
+#if RENDERER_X86
+RENDERER_TARGET_SSE41
+static int rasterRowSSE41(const RasterRowIn& in, int x0, int x1, float* zrow, RasterRowOut* out) {
+    const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+    __m128i e[3], step[3];
+    for (int k = 0; k < 3; ++k) {
+        e[k] = _mm_add_epi32(_mm_set1_epi32((int)in.E[k]), _mm_mullo_epi32(lane, _mm_set1_epi32((int)in.stepX[k])));
+        step[k] = _mm_set1_epi32((int)(in.stepX[k] * 4));
+    }
+    const __m128 zRow = _mm_set1_ps(in.zRow), dzdx = _mm_set1_ps(in.dzdx), zLo = _mm_set1_ps(in.zLo), zHi = _mm_set1_ps(in.zHi);
+    __m128i dx = _mm_add_epi32(_mm_set1_epi32(x0 - in.ox), lane);
+    const __m128i dxStep = _mm_set1_epi32(4);
+    int n = 0, x = x0;
+    for (; x + 3 <= x1; x += 4) {
+        __m128 outside = _mm_castsi128_ps(_mm_srai_epi32(_mm_or_si128(_mm_or_si128(e[0], e[1]), e[2]), 31));
+        if (_mm_movemask_ps(outside) != 0xF) {
+            __m128 z = _mm_add_ps(zRow, _mm_mul_ps(_mm_cvtepi32_ps(dx), dzdx));
+            z = _mm_min_ps(_mm_max_ps(z, zLo), zHi);
+            __m128 zref = _mm_loadu_ps(zrow + x);
+            __m128 pass = _mm_andnot_ps(outside, _mm_cmplt_ps(z, zref));
+            _mm_storeu_ps(zrow + x, _mm_blendv_ps(zref, z, pass));
+            int m = _mm_movemask_ps(pass);
+            if (!out) n += popcountMask((unsigned)m);
+            else if (m) {
+                alignas(16) float Z[4]; _mm_store_ps(Z, z);
+                for (int i = 0; i < 4; ++i) if (m & (1 << i)) { out->x[n] = x + i; out->z[n] = Z[i]; ++n; }
+            }
+        }
+        for (int k = 0; k < 3; ++k) e[k] = _mm_add_epi32(e[k], step[k]);
+        dx = _mm_add_epi32(dx, dxStep);
+    }
+    // 不足 4 个像素的尾部走标量
+    return (x <= x1) ? rasterRowScalarAt(in, x0, x, x1, zrow, out, n) : n;
+}
+
+RENDERER_TARGET_AVX2
+static int rasterRowAVX2(const RasterRowIn& in, int x0, int x1, float* zrow, RasterRowOut* out) {
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i e[3], step[3];
+    for (int k = 0; k < 3; ++k) {
+        e[k] = _mm256_add_epi32(_mm256_set1_epi32((int)in.E[k]), _mm256_mullo_epi32(lane, _mm256_set1_epi32((int)in.stepX[k])));
+        step[k] = _mm256_set1_epi32((int)(in.stepX[k] * 8));
+    }
+    const __m256 zRow = _mm256_set1_ps(in.zRow), dzdx = _mm256_set1_ps(in.dzdx), zLo = _mm256_set1_ps(in.zLo), zHi = _mm256_set1_ps(in.zHi);
+    __m256i dx = _mm256_add_epi32(_mm256_set1_epi32(x0 - in.ox), lane);
+    const __m256i dxStep = _mm256_set1_epi32(8);
+    int n = 0, x = x0;
+    for (; x + 7 <= x1; x += 8) {
+        __m256 outside = _mm256_castsi256_ps(_mm256_srai_epi32(_mm256_or_si256(_mm256_or_si256(e[0], e[1]), e[2]), 31));
+        if (_mm256_movemask_ps(outside) != 0xFF) {
+            __m256 z = _mm256_add_ps(zRow, _mm256_mul_ps(_mm256_cvtepi32_ps(dx), dzdx));
+            z = _mm256_min_ps(_mm256_max_ps(z, zLo), zHi);
+            __m256 zref = _mm256_loadu_ps(zrow + x);
+            __m256 pass = _mm256_andnot_ps(outside, _mm256_cmp_ps(z, zref, _CMP_LT_OQ));
+            _mm256_storeu_ps(zrow + x, _mm256_blendv_ps(zref, z, pass));
+            int m = _mm256_movemask_ps(pass);
+            if (!out) n += popcountMask((unsigned)m);
+            else if (m) {
+                alignas(32) float Z[8]; _mm256_store_ps(Z, z);
+                for (int i = 0; i < 8; ++i) if (m & (1 << i)) { out->x[n] = x + i; out->z[n] = Z[i]; ++n; }
+            }
+        }
+        for (int k = 0; k < 3; ++k) e[k] = _mm256_add_epi32(e[k], step[k]);
+        dx = _mm256_add_epi32(dx, dxStep);
+    }
+    return (x <= x1) ? rasterRowScalarAt(in, x0, x, x1, zrow, out, n) : n;
+}
+#endif
+
+static inline RasterRowFn rasterRowFnFor(SimdLevel l) {
+#if RENDERER_X86
+    if (l == SimdLevel::AVX2) return rasterRowAVX2;
+    if (l == SimdLevel::SSE41) return rasterRowSSE41;
+#else
+    (void)l;
+#endif
+    return rasterRowScalar;
+}
+
+// 当前光栅内核：启动时按 CPUID 选择，可在运行时降级以便对比
+static inline SimdLevel& rasterSimdLevel() {
+    static SimdLevel level = detectSimdLevel();
+    return level;
+}
@@ -0,0 +1,465 @@
+#pragma once
+// 绘制提交接口：每帧 beginFrame -> submit（网格、模型矩阵、纹理、状态）/ submitInstanced -> endFrame。
+// endFrame 把命令按 状态 -> 纹理 -> 由近到远 排序后执行阴影通道与相机通道：
+// 同纹理的绘制连在一起（纹理缓存局部性），近处先画（HiZ / 早期深度测试拒绝更多片元）
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "buffers.hpp"
+#include "texture.hpp"
+#include "pipeline.hpp"
+#include "vertex_batch.hpp"
+#include "raster.hpp"
+#include "light.hpp"
+#include "thread_pool.hpp"
+#include "binning.hpp"
+#include "visbuffer.hpp"
+#include "msaa.hpp"
+#include "arena.hpp"
+#include "meshlet.hpp"
+#include "scene.hpp"
+
+static const size_t kVertexGrain = 4096; // 顶点阶段每个并行任务的顶点数
+static const size_t kInstanceGrain = 64;  // 实例化绘制逐实例准备（剔除、变换矩阵）每个并行任务的实例数
+// 实例化绘制每批最多变换的顶点数（网格本身更大时每批一个实例）。超过一批的绘制共用一份批缓冲，
+// 缓冲被下一批覆盖前先把已登记的绘制分桶、光栅化（相机通道还要解析），帧内顶点内存不随实例数增长；
+// 批内顶点下标 = 批内槽 * 顶点数 < max(本值, 顶点数)，不会溢出 int
+static const size_t kInstanceBatchVerts = 1u << 18;
+
+// 每个绘制各自的状态（参与排序）
+struct DrawState {
+    bool cullBackFaces = true; // 相机通道背面剔除
+    bool castShadows = true;   // 写入阴影贴图
+};
+
+// 绘制参与的通道；调用方做过对象级剔除时可只提交可见的通道
+enum DrawPass : unsigned { kPassCamera = 1u, kPassShadow = 2u, kPassAll = 3u };
+
+// 整帧的渲染设置（选择特化内核）
+struct RenderSettings {
+    ShadingMode mode = ShadingMode::Shaded;
+    bool bilinear = true, lighting = true, shadows = true;
+    bool visibilityBuffer = true; // 先写三角形编号，再逐像素着色一次（关闭则为前向着色）
+    bool meshletCulling = true;   // 顶点阶段之前按簇剔除（视锥 + 法线锥）
+    bool cullFrontInShadow = true; // 阴影通道剔除正面以减弱 acne
+    int msaaSamples = 0;          // 0 / 4 / 8；MSAA 总是走可见性缓冲路径
+    glm::vec3 ambient{ 0.15f }, lightColor{ 1.0f };
+    glm::vec3 clearColor{ 0.07f, 0.07f, 0.1f };
+};
+
+class Renderer {
+public:
+    Renderer(int width, int height, int shadowW, int shadowH, unsigned threads = 0)
+        : pool_(threads), fb_(width, height), zbuf_(width, height), shadowMap_(shadowW, shadowH), visBuf_(width, height) {
+        shadowBins_.resize(shadowW, shadowH);
+        camBins_.resize(width, height);
+    }
+    Renderer(const Renderer&) = delete;
+    Renderer& operator=(const Renderer&) = delete;
+
+    RenderSettings settings;
+
+    // 帧开头调用：重置帧内存与命令表，建立相机与光源矩阵
+    void beginFrame(const glm::mat4& view, const glm::mat4& proj, const glm::vec3& eye, const glm::vec3& lightDirWS) {
+        arena_.reset();
+        cmds_.clear(); textures_.clear();
+        V_ = view; VP_ = proj * view; eye_ = eye; lightDir_ = glm::normalize(lightDirWS);
+        glm::mat4 Lview, Lproj; buildLightMatrices(lightDirWS, Lview, Lproj, LVP_);
+        extractFrustumPlanes(VP_, camPlanes_); extractFrustumPlanes(LVP_, lightPlanes_);
+    }
+
+    // 登记一次绘制（只记录，不执行）。mesh 与 lightCache 须存活到 endFrame；
+    // lightCache 非空时光空间顶点跨帧复用，否则每帧在帧内存中重新变换
+    void submit(const SceneMesh& mesh, const glm::mat4& model, const Texture2D* texture, DrawState state = DrawState(),
+        LightVertexCache* lightCache = nullptr, unsigned passes = kPassAll) {
+        if (!state.castShadows) passes &= ~kPassShadow;
+        if (!passes || !mesh.triCount()) return;
+        DrawCmd c;
+        c.mesh = &mesh; c.model = model; c.texture = texture; c.state = state; c.lightCache = lightCache; c.passes = passes;
+        c.key = sortKey(state, texture, viewDepth(mesh, model));
+        cmds_.push_back(c);
+    }
+
+    // 实例化绘制：同一网格按 models[0, count) 各画一次，顶点输入只有一份；models 须存活到 endFrame。
+    // 提交时逐实例按包围盒做视锥剔除，可见实例由近到远排列；endFrame 中各实例的变换矩阵（含法线矩阵）
+    // 与簇剔除成批并行完成，顶点阶段与分桶把一批实例（见 kInstanceBatchVerts）当作一次绘制处理
+    // （分桶 chunk 数随三角形数而非实例数增长）。光空间顶点不跨帧缓存，每帧在帧内存或批缓冲中变换
+    void submitInstanced(const SceneMesh& mesh, const glm::mat4* models, size_t count, const Texture2D* texture,
+        DrawState state = DrawState(), unsigned passes = kPassAll) {
+        if (!state.castShadows) passes &= ~kPassShadow;
+        if (!passes || !mesh.triCount() || !count) return;
+        InstanceRef* list = arena_.allocArray<InstanceRef>(count);
+        size_t n = 0; unsigned used = 0;
+        for (size_t k = 0; k < count; ++k) {
+            Aabb box = transformAabb(mesh.bounds, models[k]);
+            unsigned p = 0;
+            if ((passes & kPassCamera) && !aabbOutsideFrustum(box, camPlanes_)) p |= kPassCamera;
+            if ((passes & kPassShadow) && !aabbOutsideFrustum(box, lightPlanes_)) p |= kPassShadow;
+            if (!p) continue;
+            list[n++] = InstanceRef{ viewDepth(mesh, models[k]), (int)k, p };
+            used |= p;
+        }
+        if (!n) return;
+        std::sort(list, list + n, [](const InstanceRef& a, const InstanceRef& b) { return a.depth < b.depth || (a.depth == b.depth && a.index < b.index); });
+        DrawCmd c;
+        c.mesh = &mesh; c.model = glm::mat4(1.0f); c.texture = texture; c.state = state; c.lightCache = nullptr; c.passes = used;
+        c.instances = models; c.inst = list; c.instCount = n;
+        c.key = sortKey(state, texture, list[0].depth); // 按最近的实例排序
+        cmds_.push_back(c);
+    }
+
+    // 排序并执行本帧的全部绘制，结果在 framebuffer()
+    void endFrame() {
+        const RenderSettings& st = settings;
+        const int W = fb_.w, H = fb_.h, SW = shadowMap_.w, SH = shadowMap_.h;
+        const size_t n = cmds_.size();
+        std::sort(cmds_.begin(), cmds_.end(), [](const DrawCmd& a, const DrawCmd& b) { return a.key < b.key; });
+        // 键相同（同状态、同纹理、同视深）的绘制之间顺序不保证同提交顺序，但对同一输入是确定的
+
+        // 簇剔除：相机视锥 + 背面锥，光源视锥 + 正面锥；被剔除簇的顶点不变换、三角形不分桶
+        // 实例化绘制只有一批时三角形在这里拼好，分多批的在各通道中逐批生成
+        MeshletFrame* mfs = arena_.allocArray<MeshletFrame>(n);
+        InstanceFrame* ifs = arena_.allocArray<InstanceFrame>(n);
+        size_t instances = 0;
+        for (size_t i = 0; i < n; ++i) {
+            const DrawCmd& c = cmds_[i]; const SceneMesh& m = *c.mesh;
+            if (c.inst) {
+                ifs[i] = prepareInstances(c, st.meshletCulling);
+                instances += c.instCount;
+                mfs[i] = MeshletFrame();
+                if (c.instCount > ifs[i].batch) continue;
+                const size_t ns = c.instCount, nb = vertexBlockCount(m.source().size());
+                const InstanceFrame& f = ifs[i];
+                glm::ivec3* camIdx = arena_.allocArray<glm::ivec3>(f.camOff[ns]); glm::ivec3* lightIdx = arena_.allocArray<glm::ivec3>(f.lightOff[ns]);
+                std::uint8_t* camBlocks = arena_.allocArray<std::uint8_t>(ns * nb); std::uint8_t* lightBlocks = arena_.allocArray<std::uint8_t>(ns * nb);
+                mfs[i].camIdx = camIdx; mfs[i].camTris = instanceBatch(c, f, 0, ns, kPassCamera, kPassCamera, camIdx, camBlocks);
+                mfs[i].lightIdx = lightIdx; mfs[i].lightTris = instanceBatch(c, f, 0, ns, kPassShadow, kPassAll, lightIdx, lightBlocks);
+                mfs[i].camBlocks = camBlocks; mfs[i].lightBlocks = lightBlocks;
+                continue;
+            }
+            ++instances;
+            bool inCam = (c.passes & kPassCamera) != 0, inLight = (c.passes & kPassShadow) != 0;
+            if (!st.meshletCulling) {
+                mfs[i] = m.idx16.empty() ? allMeshlets(m.meshlets, m.idx.data(), m.idx.size(), inCam, inLight)
+                    : allMeshlets(m.meshlets, m.idx16.data(), m.idx16.size(), inCam, inLight, arena_);
+                continue;
+            }
+            MeshletCullView camView = makeMeshletCullView(VP_ * c.model, c.model, eye_, true, c.state.cullBackFaces ? 1 : 0);
+            MeshletCullView lightView = makeMeshletCullView(LVP_ * c.model, c.model, -lightDir_, false, st.cullFrontInShadow ? -1 : 0);
+            mfs[i] = m.idx16.empty() ? cullMeshlets(m.meshlets, m.idx.data(), inCam ? &camView : nullptr, inLight ? &lightView : nullptr, arena_)
+                : cullMeshlets(m.meshlets, m.idx16.data(), inCam ? &camView : nullptr, inLight ? &lightView : nullptr, arena_);
+        }
+
+        // ---------- Shadow Pass ----------
+        // 顶点阶段与分桶按块并行；光栅化按 tile 并行（tile 之间互不重叠，无需加锁）
+        // 光空间顶点也供相机通道的 lightClip 使用，所以只在相机通道可见的绘制也要变换（分批的实例化绘制除外，
+        // 相机通道由 xf.LM 重新计算）
+        const ShadowVOut** lightVerts = arena_.allocArray<const ShadowVOut*>(n);
+        const bool cullFront = st.cullFrontInShadow;
+        bool first = true, batchPending = false; // batchPending：批缓冲里的顶点还被分桶表引用
+        // 分桶并光栅化已登记的绘制，阴影贴图只在第一轮清空
+        auto flushShadow = [&]() {
+            pool_.parallelFor(shadowBins_.chunkCount, [&](int c, int) {
+                binChunk(shadowBins_, c, [&](const ShadowVOut& A, const ShadowVOut& B, const ShadowVOut& C) { return acceptTriangleDepth(A, B, C, cullFront); });
+                });
+            pool_.parallelFor(shadowBins_.tileCount(), [&](int t, int) {
+                RectI r = shadowBins_.tileRect(t);
+                if (first) shadowMap_.clear(1.0f, r);
+                forEachBinnedTriangle(shadowBins_, t, [&](const BinChunk<ShadowVOut>&, const ShadowVOut& A, const ShadowVOut& B, const ShadowVOut& C) {
+                    rasterTriangleDepth(A, B, C, shadowMap_, cullFront, r);
+                    });
+                });
+            shadowBins_.beginFrame();
+            first = batchPending = false;
+        };
+        shadowBins_.beginFrame();
+        for (size_t i = 0; i < n; ++i) {
+            const DrawCmd& c = cmds_[i]; const VertexSource in = c.mesh->source();
+            if (c.inst && c.instCount > ifs[i].batch) {
+                const InstanceFrame& f = ifs[i];
+                const size_t nv = in.size(), nb = vertexBlockCount(nv);
+                lightVerts[i] = nullptr;
+                for (size_t sb = 0; sb < c.instCount; sb += f.batch) {
+                    const size_t se = std::min(c.instCount, sb + f.batch), nt = f.lightOff[se] - f.lightOff[sb];
+                    if (!nt) continue;
+                    if (batchPending) flushShadow();
+                    reserveBatch(nt, (se - sb) * nb);
+                    if (batchLightVerts_.size() < (se - sb) * nv) batchLightVerts_.resize((se - sb) * nv);
+                    std::uint8_t* blocks = batchBlocks_.data(); ShadowVOut* lv = batchLightVerts_.data();
+                    instanceBatch(c, f, sb, se, kPassShadow, kPassShadow, batchIdx_.data(), blocks);
+                    pool_.parallelRange((se - sb) * nb, kVertexGrain / kVertexBlock, [&](size_t b, size_t e, int) {
+                        forEachInstanceRun(blocks, nb, nv, b, e, [&](size_t j, size_t vb, size_t ve) { vertexStageLightBatch(in, vb, ve, f.lightXf[sb + j], lv + j * nv); });
+                        });
+                    shadowBins_.addDraw(lv, batchIdx_.data(), nt, (int)i);
+                    batchPending = true;
+                }
+                continue;
+            }
+            if (c.inst) {
+                const size_t nv = in.size(), nb = vertexBlockCount(nv);
+                ShadowVOut* lv = arena_.allocArray<ShadowVOut>(c.instCount * nv);
+                const VertexXform* lxf = ifs[i].lightXf;
+                pool_.parallelRange(c.instCount * nb, kVertexGrain / kVertexBlock, [&](size_t b, size_t e, int) {
+                    forEachInstanceRun(mfs[i].lightBlocks, nb, nv, b, e, [&](size_t s, size_t vb, size_t ve) { vertexStageLightBatch(in, vb, ve, lxf[s], lv + s * nv); });
+                    });
+                lightVerts[i] = lv;
+            } else if (LightVertexCache* lc = c.lightCache) {
+                lc->update(in, c.model, LVP_, SW, SH);
+                pool_.parallelRange(lc->blockCount(), kVertexGrain / kVertexBlock, [&](size_t b, size_t e, int) { lc->transformBlocks(mfs[i].lightBlocks, b, e); });
+                lightVerts[i] = lc->verts.data();
+            } else {
+                ShadowVOut* lv = arena_.allocArray<ShadowVOut>(in.size());
+                VertexXform lxf = makeLightXform(c.model, LVP_, SW, SH);
+                pool_.parallelRange(vertexBlockCount(in.size()), kVertexGrain / kVertexBlock, [&](size_t b, size_t e, int) {
+                    forEachMarkedRun(mfs[i].lightBlocks, b, e, in.size(), [&](size_t vb, size_t ve) { vertexStageLightBatch(in, vb, ve, lxf, lv); });
+                    });
+                lightVerts[i] = lv;
+            }
+            shadowBins_.addDraw(lightVerts[i], mfs[i].lightIdx, mfs[i].lightTris, (int)i);
+        }
+        flushShadow();
+
+        // ---------- Camera Pass ----------
+        // 绘制编号 = 排序后的命令下标，drawTex / cull 按它取
+        const Texture2D** drawTex = arena_.allocArray<const Texture2D*>(n);
+        bool* drawCull = arena_.allocArray<bool>(n);
+        const int msaa = st.msaaSamples;
+        if (msaa && msaaBuf_.samples != msaa) msaaBuf_.resize(W, H, msaa);
+        camBins_.coverPad = msaa ? kMsaaSampleReach : 0; // 只覆盖采样点的三角形也要分桶
+        std::uint32_t clearColor = packARGB8(st.clearColor);
+        // 按当前渲染状态选一次特化内核
+        RasterTexFn rasterTex = rasterTexFnFor(st.mode, st.bilinear, st.shadows, st.lighting);
+        ResolveVisFn resolveVis = resolveVisFnFor(st.mode, st.bilinear, st.shadows, st.lighting);
+        ResolveMsaaFn resolveMsaa = resolveMsaaFnFor(st.mode, st.bilinear, st.shadows, st.lighting);
+        const glm::vec3 Ldir = lightDir_, ambient = st.ambient, lightColor = st.lightColor;
+        // 分桶、光栅化并解析已登记的绘制。深度与像素跨轮保留：第一轮清空缓冲，
+        // 之后各轮只重新着色被新三角形覆盖的像素（MSAA 另存各采样点颜色）；last 为本帧最后一轮
+        first = true; batchPending = false;
+        auto flushCamera = [&](bool last) {
+            pool_.parallelFor(camBins_.chunkCount, [&](int c, int) {
+                bool cull = drawCull[camBins_.chunks[c].draw];
+                binChunk(camBins_, c, [&](const VertexOut& A, const VertexOut& B, const VertexOut& C) { return acceptTriangleTex(A, B, C, cull); });
+                });
+            std::uint32_t* history = (msaa && !(first && last)) ? msaaBuf_.sampleColors() : nullptr;
+            pool_.parallelFor(camBins_.tileCount(), [&](int t, int) {
+                RectI r = camBins_.tileRect(t);
+                if (msaa) {
+                    if (first) msaaBuf_.clear(r); else msaaBuf_.clearIds(r);
+                    forEachBinnedTriangleId(camBins_, t, [&](std::uint32_t id, const BinChunk<VertexOut>& c, const VertexOut& A, const VertexOut& B, const VertexOut& C) {
+                        rasterTriangleMsaa(A, B, C, id, msaaBuf_, drawCull[c.draw], r);
+                        });
+                    resolveMsaa(msaaBuf_, camBins_, r, drawTex, fb_, clearColor, first, history, shadowMap_, Ldir, ambient, lightColor);
+                    return;
+                }
+                if (first) zbuf_.clear(1.0f, r);
+                if (st.visibilityBuffer) {
+                    visBuf_.clear(r);
+                    forEachBinnedTriangleId(camBins_, t, [&](std::uint32_t id, const BinChunk<VertexOut>& c, const VertexOut& A, const VertexOut& B, const VertexOut& C) {
+                        rasterTriangleVis(A, B, C, id, visBuf_, zbuf_, drawCull[c.draw], r);
+                        });
+                    resolveVis(visBuf_, zbuf_, camBins_, r, drawTex, fb_, clearColor, first, shadowMap_, Ldir, ambient, lightColor);
+                    return;
+                }
+                if (first) fb_.clear(clearColor, r);
+                forEachBinnedTriangle(camBins_, t, [&](const BinChunk<VertexOut>& c, const VertexOut& A, const VertexOut& B, const VertexOut& C) {
+                    rasterTex(A, B, C, *drawTex[c.draw], fb_, zbuf_, shadowMap_, drawCull[c.draw], Ldir, ambient, lightColor, r);
+                    });
+                });
+            camBins_.beginFrame();
+            first = batchPending = false;
+        };
+        camBins_.beginFrame();
+        for (size_t i = 0; i < n; ++i) {
+            const DrawCmd& c = cmds_[i];
+            drawTex[i] = c.texture; drawCull[i] = c.state.cullBackFaces;
+            if (!(c.passes & kPassCamera)) continue;
+            const VertexSource in = c.mesh->source();
+            if (c.inst && c.instCount > ifs[i].batch) {
+                const InstanceFrame& f = ifs[i];
+                const size_t nv = in.size(), nb = vertexBlockCount(nv);
+                for (size_t sb = 0; sb < c.instCount; sb += f.batch) {
+                    const size_t se = std::min(c.instCount, sb + f.batch), nt = f.camOff[se] - f.camOff[sb];
+                    if (!nt) continue;
+                    if (batchPending) flushCamera(false);
+                    reserveBatch(nt, (se - sb) * nb);
+                    if (batchVerts_.size() < (se - sb) * nv) batchVerts_.resize((se - sb) * nv);
+                    std::uint8_t* blocks = batchBlocks_.data(); VertexOut* vo = batchVerts_.data();
+                    instanceBatch(c, f, sb, se, kPassCamera, kPassCamera, batchIdx_.data(), blocks);
+                    pool_.parallelRange((se - sb) * nb, kVertexGrain / kVertexBlock, [&](size_t b, size_t e, int) {
+                        forEachInstanceRun(blocks, nb, nv, b, e, [&](size_t j, size_t vb, size_t ve) { vertexStageBatch(in, vb, ve, f.camXf[sb + j], nullptr, vo + j * nv); });
+                        });
+                    camBins_.addDraw(vo, batchIdx_.data(), nt, (int)i);
+                    batchPending = true;
+                }
+                continue;
+            }
+            if (c.inst) {
+                const size_t nv = in.size(), nb = vertexBlockCount(nv);
+                VertexOut* vo = arena_.allocArray<VertexOut>(c.instCount * nv);
+                const ShadowVOut* lv = lightVerts[i]; const VertexXform* xf = ifs[i].camXf;
+                pool_.parallelRange(c.instCount * nb, kVertexGrain / kVertexBlock, [&](size_t b, size_t e, int) {
+                    forEachInstanceRun(mfs[i].camBlocks, nb, nv, b, e, [&](size_t s, size_t vb, size_t ve) { vertexStageBatch(in, vb, ve, xf[s], lv + s * nv, vo + s * nv); });
+                    });
+                camBins_.addDraw(vo, mfs[i].camIdx, mfs[i].camTris, (int)i);
+                continue;
+            }
+            VertexXform xf = makeVertexXform(c.model, VP_ * c.model, LVP_, glm::transpose(glm::inverse(glm::mat3(c.model))), W, H);
+            VertexOut* vo = arena_.allocArray<VertexOut>(in.size());
+            const ShadowVOut* lv = lightVerts[i];
+            pool_.parallelRange(vertexBlockCount(in.size()), kVertexGrain / kVertexBlock, [&](size_t b, size_t e, int) {
+                forEachMarkedRun(mfs[i].camBlocks, b, e, in.size(), [&](size_t vb, size_t ve) { vertexStageBatch(in, vb, ve, xf, lv, vo); });
+                });
+            camBins_.addDraw(vo, mfs[i].camIdx, mfs[i].camTris, (int)i);
+        }
+        flushCamera(true);
+        lastDraws_ = n; lastInstances_ = instances;
+    }
+
+    const Framebuffer& framebuffer() const { return fb_; }
+    const DepthBuffer& shadowMap() const { return shadowMap_; }
+    const glm::mat4& viewProj() const { return VP_; }
+    const glm::mat4& lightViewProj() const { return LVP_; } // beginFrame 之后有效
+    FrameArena& arena() { return arena_; } // 帧内临时内存，调用方也可在 beginFrame 与 endFrame 之间使用
+    ThreadPool& pool() { return pool_; }
+    size_t lastDrawCount() const { return lastDraws_; }
+    size_t lastInstanceCount() const { return lastInstances_; } // 上一帧绘制的实例数（普通绘制计 1）
+
+private:
+    // 实例化绘制中通过视锥剔除的实例（实例槽按 depth 升序）
+    struct InstanceRef {
+        float depth;
+        int index;       // models 下标
+        unsigned passes; // 该实例可见的通道
+    };
+
+    struct DrawCmd {
+        const SceneMesh* mesh;
+        glm::mat4 model;
+        const Texture2D* texture;
+        DrawState state;
+        LightVertexCache* lightCache;
+        unsigned passes;
+        std::uint64_t key;
+        const glm::mat4* instances = nullptr; // 非空为实例化绘制
+        const InstanceRef* inst = nullptr;
+        size_t instCount = 0;
+    };
+
+    // 排序键：状态 | 纹理（按本帧首次出现编号）| 视深（正浮点数的位模式与大小同序）
+    std::uint64_t sortKey(const DrawState& state, const Texture2D* texture, float depth) {
+        size_t tex = std::find(textures_.begin(), textures_.end(), texture) - textures_.begin();
+        if (tex == textures_.size()) textures_.push_back(texture);
+        std::uint32_t depthBits; std::memcpy(&depthBits, &depth, sizeof(depthBits));
+        return ((std::uint64_t)(state.cullBackFaces ? 0u : 1u) << 48) | ((std::uint64_t)(tex & 0xffffu) << 32) | depthBits;
+    }
+    // 包围盒中心的视深
+    float viewDepth(const SceneMesh& mesh, const glm::mat4& model) const {
+        return std::max(0.0f, -(V_ * (model * glm::vec4(mesh.bounds.center(), 1.0f))).z);
+    }
+
+    // 实例化绘制的逐实例准备结果（帧内存）
+    struct InstanceFrame {
+        VertexXform* camXf;
+        VertexXform* lightXf;
+        const std::uint8_t* vis;   // 槽 s 的第 k 个簇：vis[s * 簇数 + k]，相机 (1) / 光源 (2) 可见，与 DrawPass 同位
+        const size_t* camOff;      // 可见三角形数的前缀和（ns + 1 项）
+        const size_t* lightOff;
+        size_t batch;              // 每批实例数
+    };
+
+    // 实例化绘制的逐实例准备，按实例并行：相机 / 光源变换矩阵（法线矩阵一并求出）与簇剔除
+    InstanceFrame prepareInstances(const DrawCmd& c, bool meshletCulling) {
+        const SceneMesh& m = *c.mesh; const MeshletMesh& mm = m.meshlets;
+        const size_t ns = c.instCount, nm = mm.meshlets.size(), nv = m.source().size();
+        const int W = fb_.w, H = fb_.h, SW = shadowMap_.w, SH = shadowMap_.h, cullFront = settings.cullFrontInShadow ? -1 : 0;
+        VertexXform* camXf = arena_.allocArray<VertexXform>(ns); VertexXform* lightXf = arena_.allocArray<VertexXform>(ns);
+        std::uint8_t* vis = arena_.allocArray<std::uint8_t>(ns * nm);
+        size_t* camOff = arena_.allocArray<size_t>(ns + 1); size_t* lightOff = arena_.allocArray<size_t>(ns + 1);
+        pool_.parallelRange(ns, kInstanceGrain, [&](size_t b, size_t e, int) {
+            for (size_t s = b; s < e; ++s) {
+                const InstanceRef& r = c.inst[s]; const glm::mat4& M = c.instances[r.index];
+                const bool inCam = (r.passes & kPassCamera) != 0, inLight = (r.passes & kPassShadow) != 0;
+                const glm::mat4 MVP = VP_ * M;
+                lightXf[s] = makeLightXform(M, LVP_, SW, SH);
+                if (inCam) camXf[s] = makeVertexXform(M, MVP, LVP_, glm::transpose(glm::inverse(glm::mat3(M))), W, H);
+                MeshletCullView camView{}, lightView{};
+                if (meshletCulling) {
+                    camView = makeMeshletCullView(MVP, M, eye_, true, c.state.cullBackFaces ? 1 : 0);
+                    lightView = makeMeshletCullView(LVP_ * M, M, -lightDir_, false, cullFront);
+                }
+                size_t ct = 0, lt = 0;
+                for (size_t k = 0; k < nm; ++k) {
+                    const Meshlet& ml = mm.meshlets[k];
+                    bool cv = inCam && (!meshletCulling || meshletVisible(ml, camView));
+                    bool lv = inLight && (!meshletCulling || meshletVisible(ml, lightView));
+                    vis[s * nm + k] = (std::uint8_t)((cv ? 1 : 0) | (lv ? 2 : 0));
+                    if (cv) ct += ml.triCount;
+                    if (lv) lt += ml.triCount;
+                }
+                camOff[s + 1] = ct; lightOff[s + 1] = lt;
+            }
+            });
+        camOff[0] = lightOff[0] = 0;
+        for (size_t s = 0; s < ns; ++s) { camOff[s + 1] += camOff[s]; lightOff[s + 1] += lightOff[s]; }
+        InstanceFrame f;
+        f.camXf = camXf; f.lightXf = lightXf; f.vis = vis; f.camOff = camOff; f.lightOff = lightOff;
+        f.batch = std::max<size_t>(1, kInstanceBatchVerts / std::max<size_t>(1, nv));
+        return f;
+    }
+
+    // 实例槽 [sb, se) 中 pass 可见簇的三角形按槽拼到 idx，顶点下标加上批内槽偏移 (s - sb) * 顶点数；
+    // blocks 按 批内槽 * 块数 排布，标记 blockPass 中任一通道可见的簇用到的顶点块。返回三角形数
+    size_t instanceBatch(const DrawCmd& c, const InstanceFrame& f, size_t sb, size_t se, unsigned pass, unsigned blockPass,
+        glm::ivec3* idx, std::uint8_t* blocks) {
+        const SceneMesh& m = *c.mesh; const MeshletMesh& mm = m.meshlets;
+        const size_t nm = mm.meshlets.size(), nv = m.source().size(), nb = vertexBlockCount(nv);
+        const size_t* off = (pass == kPassCamera) ? f.camOff : f.lightOff;
+        const glm::ivec3* idx32 = m.idx.data(); const Tri16* idx16 = m.idx16.empty() ? nullptr : m.idx16.data();
+        pool_.parallelRange(se - sb, kInstanceGrain, [&](size_t b, size_t e, int) {
+            for (size_t j = b; j < e; ++j) {
+                const size_t s = sb + j;
+                std::uint8_t* bl = blocks + j * nb;
+                std::memset(bl, 0, nb);
+                const glm::ivec3 o((int)(j * nv));
+                size_t t0 = off[s] - off[sb];
+                for (size_t k = 0; k < nm; ++k) {
+                    const unsigned v = f.vis[s * nm + k];
+                    if (!(v & blockPass)) continue;
+                    const Meshlet& ml = mm.meshlets[k];
+                    if (v & pass)
+                        for (std::uint32_t t = ml.triBegin; t < ml.triBegin + ml.triCount; ++t) idx[t0++] = (idx16 ? expandTri(idx16[t]) : idx32[t]) + o;
+                    for (std::uint32_t i = ml.blockBegin; i < ml.blockBegin + ml.blockCount; ++i) bl[mm.blocks[i]] = 1;
+                }
+            }
+            });
+        return off[se] - off[sb];
+    }
+
+    // 批缓冲只增不减；调用前须确认旧内容已不被分桶表引用
+    void reserveBatch(size_t tris, size_t blocks) {
+        if (batchIdx_.size() < tris) batchIdx_.resize(tris);
+        if (batchBlocks_.size() < blocks) batchBlocks_.resize(blocks);
+    }
+
+    ThreadPool pool_;
+    Framebuffer fb_;
+    DepthBuffer zbuf_, shadowMap_;
+    VisBuffer visBuf_;
+    MsaaBuffer msaaBuf_; // 开启 MSAA 时按采样数分配
+    TileBins<ShadowVOut> shadowBins_;
+    TileBins<VertexOut> camBins_;
+    FrameArena arena_; // 帧内临时缓冲（顶点阶段输出等），每帧开头重置
+    std::vector<DrawCmd> cmds_; // 跨帧复用容量
+    // 实例化绘制的批缓冲（跨帧复用）：三角形、顶点块标记、阴影 / 相机通道的顶点
+    std::vector<glm::ivec3> batchIdx_;
+    std::vector<std::uint8_t> batchBlocks_;
+    std::vector<ShadowVOut> batchLightVerts_;
+    std::vector<VertexOut> batchVerts_;
+    std::vector<const Texture2D*> textures_;
+    glm::mat4 V_{ 1.0f }, VP_{ 1.0f }, LVP_{ 1.0f };
+    glm::vec4 camPlanes_[6], lightPlanes_[6]; // 世界空间视锥平面，实例剔除用
+    glm::vec3 eye_{ 0.0f }, lightDir_{ 0.0f, 1.0f, 0.0f };
+    size_t lastDraws_ = 0, lastInstances_ = 0;
+};
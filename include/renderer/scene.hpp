@@ -0,0 +1,290 @@
+#pragma once
+// 场景：网格（可带 LOD 链）+ 对象（网格、纹理、模型矩阵），对象的世界包围盒组织成 BVH。
+// 对象移动后只 refit 其到根的路径；每帧按相机与光源视锥各遍历一次 BVH，逐帧工作量随可见对象而非场景总量增长
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <memory>
+#include <glm/glm.hpp>
+#include "mesh.hpp"
+#include "pipeline.hpp"
+#include "vertex_batch.hpp"
+#include "meshlet.hpp"
+#include "simplify.hpp"
+#include "arena.hpp"
+
+class MappedFile;
+
+struct Aabb {
+    glm::vec3 mn{ 1e30f }, mx{ -1e30f };
+    void grow(const glm::vec3& p) { mn = glm::min(mn, p); mx = glm::max(mx, p); }
+    void grow(const Aabb& b) { mn = glm::min(mn, b.mn); mx = glm::max(mx, b.mx); }
+    glm::vec3 center() const { return (mn + mx) * 0.5f; }
+};
+
+// 仿射变换后的包围盒（按列累加极值），并略微外扩：包围盒级剔除不能比逐三角形的外码判定更激进
+static inline Aabb transformAabb(const Aabb& b, const glm::mat4& M) {
+    Aabb r; r.mn = r.mx = glm::vec3(M[3]);
+    for (int c = 0; c < 3; ++c) {
+        glm::vec3 a = glm::vec3(M[c]) * b.mn[c], e = glm::vec3(M[c]) * b.mx[c];
+        r.mn += glm::min(a, e); r.mx += glm::max(a, e);
+    }
+    glm::vec3 pad = (r.mx - r.mn) * 1e-4f + glm::vec3(1e-6f);
+    r.mn -= pad; r.mx += pad;
+    return r;
+}
+
+// 包围盒与平面：返回 -1 完全在外侧，1 完全在内侧，0 相交
+static inline int classifyAabbPlane(const Aabb& b, const glm::vec4& P) {
+    glm::vec3 n(P), pos(n.x > 0.0f ? b.mx.x : b.mn.x, n.y > 0.0f ? b.mx.y : b.mn.y, n.z > 0.0f ? b.mx.z : b.mn.z);
+    if (glm::dot(n, pos) + P.w < 0.0f) return -1;
+    glm::vec3 neg(n.x > 0.0f ? b.mn.x : b.mx.x, n.y > 0.0f ? b.mn.y : b.mx.y, n.z > 0.0f ? b.mn.z : b.mx.z);
+    return glm::dot(n, neg) + P.w >= 0.0f ? 1 : 0;
+}
+
+// 包围盒是否在视锥（extractFrustumPlanes 的平面）某个平面之外
+static inline bool aabbOutsideFrustum(const Aabb& b, const glm::vec4 planes[6]) {
+    for (int p = 0; p < 6; ++p)
+        if (classifyAabbPlane(b, planes[p]) < 0) return true;
+    return false;
+}
+
+static const int kBvhLeafSize = 4;
+static const int kBvhMaxDepth = 64;
+
+// 节点：count > 0 为叶（items[first, first + count)），否则子节点为 first 与 first + 1
+struct BvhNode {
+    Aabb box;
+    int first = 0, count = 0, parent = -1;
+};
+
+struct SceneBvh {
+    std::vector<BvhNode> nodes;
+    std::vector<int> items;  // 叶内对象编号
+    std::vector<int> leafOf; // 对象 -> 叶节点
+
+    // 自顶向下构建：沿质心范围最长的轴按中位数二分
+    void build(const std::vector<Aabb>& boxes) {
+        nodes.clear(); items.resize(boxes.size()); leafOf.assign(boxes.size(), -1);
+        for (size_t i = 0; i < boxes.size(); ++i) items[i] = (int)i;
+        if (boxes.empty()) return;
+        nodes.reserve(2 * boxes.size() / kBvhLeafSize + 2);
+        nodes.emplace_back();
+        buildNode(0, 0, (int)items.size(), boxes);
+    }
+
+    // 对象包围盒改变后调用：重算其叶子到根路径上的包围盒（拓扑不变；对象大幅移动后宜重新 build）
+    void refit(int object, const std::vector<Aabb>& boxes) {
+        int n = leafOf[object];
+        BvhNode& leaf = nodes[n];
+        leaf.box = Aabb();
+        for (int i = leaf.first; i < leaf.first + leaf.count; ++i) leaf.box.grow(boxes[items[i]]);
+        for (n = leaf.parent; n >= 0; n = nodes[n].parent) {
+            BvhNode& b = nodes[n];
+            b.box = nodes[b.first].box; b.box.grow(nodes[b.first + 1].box);
+        }
+    }
+
+    // 对与视锥（extractFrustumPlanes 的世界空间平面）相交或在内的对象调用 f(object)。
+    // 完全在某平面内侧的子树不再测该平面
+    template<typename F>
+    void cull(const glm::vec4 planes[6], F f) const {
+        if (nodes.empty()) return;
+        int stack[kBvhMaxDepth * 2]; unsigned masks[kBvhMaxDepth * 2]; int sp = 0;
+        stack[sp] = 0; masks[sp++] = 0x3fu;
+        while (sp > 0) {
+            --sp; const BvhNode& n = nodes[stack[sp]]; unsigned mask = masks[sp];
+            if (!testBox(n.box, planes, mask)) continue;
+            if (n.count > 0) { for (int i = n.first; i < n.first + n.count; ++i) f(items[i]); continue; }
+            stack[sp] = n.first + 1; masks[sp++] = mask;
+            stack[sp] = n.first; masks[sp++] = mask;
+        }
+    }
+
+private:
+    static bool testBox(const Aabb& b, const glm::vec4 planes[6], unsigned& mask) {
+        for (int p = 0; p < 6; ++p) {
+            if (!(mask & (1u << p))) continue;
+            int c = classifyAabbPlane(b, planes[p]);
+            if (c < 0) return false;
+            if (c > 0) mask &= ~(1u << p);
+        }
+        return true;
+    }
+
+    void buildNode(int node, int first, int count, const std::vector<Aabb>& boxes) {
+        Aabb box, cbox;
+        for (int i = first; i < first + count; ++i) { box.grow(boxes[items[i]]); cbox.grow(boxes[items[i]].center()); }
+        nodes[node].box = box;
+        glm::vec3 ext = cbox.mx - cbox.mn;
+        if (count <= kBvhLeafSize || (ext.x <= 0.0f && ext.y <= 0.0f && ext.z <= 0.0f)) {
+            nodes[node].first = first; nodes[node].count = count;
+            for (int i = first; i < first + count; ++i) leafOf[items[i]] = node;
+            return;
+        }
+        int axis = (ext.x >= ext.y && ext.x >= ext.z) ? 0 : (ext.y >= ext.z ? 1 : 2);
+        int mid = first + count / 2;
+        std::nth_element(items.begin() + first, items.begin() + mid, items.begin() + first + count,
+            [&](int a, int b) { return boxes[a].center()[axis] < boxes[b].center()[axis]; });
+        int left = (int)nodes.size();
+        nodes.emplace_back(); nodes.emplace_back();
+        nodes[node].first = left; nodes[node].count = 0;
+        nodes[left].parent = nodes[left + 1].parent = node;
+        buildNode(left, first, mid - first, boxes);
+        buildNode(left + 1, mid, first + count - mid, boxes);
+    }
+};
+
+static const size_t kLodMinTris = 64;    // LOD 链最粗一级的三角形数下限
+static const float kLodPixelError = 1.0f; // 默认允许的 LOD 屏幕误差（像素）
+
+// 网格：加载时切 meshlet 并转成 SoA。压缩网格顶点输入只存 qstreams，顶点数允许时索引只存 idx16，不保留 verts
+struct SceneMesh {
+    std::vector<VertexIn> verts;
+    MeshArray<glm::ivec3> idx;
+    VertexStreams streams;
+    QuantizedStreams qstreams; // 压缩格式（见 quantize.hpp），与 streams 二选一
+    MeshArray<Tri16> idx16;    // 16 位索引，与 idx 二选一
+    MeshletMesh meshlets;
+    Aabb bounds; // 模型空间
+    std::vector<int> lods; // LOD 链（Scene::meshes 下标，由细到粗，lods[0] 为自身）；只有原网格有
+    float lodError = 0.0f; // 原网格各位置到本级表面的最大距离（模型空间，见 meshDeviation）
+    std::shared_ptr<MappedFile> storage; // 从网格缓存加载时各数组借用的映射（见 mesh_cache.hpp），不保留 verts
+
+    bool quantized() const { return qstreams.size() > 0; }
+    VertexSource source() const { return quantized() ? VertexSource(qstreams) : VertexSource(streams); }
+    size_t triCount() const { return idx16.empty() ? idx.size() : idx16.size(); }
+    // 顶点输入与索引占用的字节数
+    size_t vertexBytes() const { return quantized() ? qstreams.bytes() : streams.size() * 11 * sizeof(float); }
+    size_t indexBytes() const { return idx.size() * sizeof(glm::ivec3) + idx16.size() * sizeof(Tri16); }
+};
+
+struct SceneObject {
+    int mesh = 0, texture = 0;
+    glm::mat4 model{ 1.0f };
+    LightVertexCache light; // 光空间顶点跨帧缓存
+};
+
+// 本帧要处理的对象：至少对相机或光源之一可见
+struct VisibleObject {
+    int object;
+    bool inCam, inLight;
+};
+
+struct Scene {
+    std::vector<SceneMesh> meshes;
+    std::vector<SceneObject> objects;
+    std::vector<Aabb> bounds; // 对象的世界包围盒
+    SceneBvh bvh;
+
+    // lodLevels > 0 时用边折叠逐级简化（每级约减半三角形）生成至多 lodLevels 级 LOD，简化不动或少于 kLodMinTris 时停止。
+    // quantize 时各级都存为压缩格式（位置先吸附到量化格点再切 meshlet），建完 LOD 链后释放 verts 与 32 位索引
+    int addMesh(std::vector<VertexIn> verts, std::vector<glm::ivec3> idx, int lodLevels = 0, bool quantize = false) {
+        std::vector<glm::vec3> original; // 原网格的位置（去重），各级误差都相对它量
+        if (lodLevels > 0) {
+            for (const VertexIn& v : verts) original.push_back(v.pos);
+            std::sort(original.begin(), original.end(), positionLess);
+            original.erase(std::unique(original.begin(), original.end()), original.end());
+        }
+        int base = addMeshLevel(std::move(verts), std::move(idx), 0.0f, quantize);
+        meshes[base].lods.push_back(base);
+        for (int l = 0; l < lodLevels; ++l) {
+            const SceneMesh& prev = meshes[meshes[base].lods.back()];
+            size_t target = prev.idx.size() / 2;
+            if (target < kLodMinTris) break;
+            std::vector<VertexIn> v; std::vector<glm::ivec3> i;
+            simplifyMesh(prev.verts, prev.idx.owned(), target, v, i); // 逐级简化
+            if (i.size() * 4 > prev.idx.size() * 3) break;
+            float error = meshDeviation(original, v, i);
+            int id = addMeshLevel(std::move(v), std::move(i), error, quantize);
+            meshes[base].lods.push_back(id);
+        }
+        if (quantize)
+            for (int id : meshes[base].lods) {
+                SceneMesh& m = meshes[id];
+                std::vector<VertexIn>().swap(m.verts);
+                if (!m.idx16.empty()) m.idx = std::vector<glm::ivec3>();
+            }
+        return base;
+    }
+
+    // 按投影误差选 LOD：取误差投影到屏幕不超过 pixelError 像素的最粗一级，返回级别（网格编号为 meshes[mesh].lods[级别]）。
+    // projScale = proj[1][1] * 视口高度 / 2，即距离 1 处一个单位长度对应的像素数；距离取眼点到包围球的最近距离
+    int selectLod(int mesh, const glm::mat4& model, const glm::vec3& eye, float projScale, float pixelError = kLodPixelError) const {
+        const SceneMesh& m = meshes[mesh];
+        if (m.lods.size() <= 1) return 0;
+        float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        glm::vec3 c = glm::vec3(model * glm::vec4(m.bounds.center(), 1.0f));
+        float dist = glm::length(c - eye) - glm::length(m.bounds.mx - m.bounds.mn) * 0.5f * scale;
+        if (dist <= 0.0f) return 0;
+        float budget = pixelError * dist / (scale * projScale); // 允许的模型空间误差
+        int level = 0;
+        while (level + 1 < (int)m.lods.size() && meshes[m.lods[level + 1]].lodError <= budget) ++level;
+        return level;
+    }
+
+    int addObject(int mesh, int texture, const glm::mat4& model) {
+        objects.emplace_back();
+        SceneObject& o = objects.back();
+        o.mesh = mesh; o.texture = texture; o.model = model;
+        bounds.push_back(transformAabb(meshes[mesh].bounds, model));
+        structureDirty_ = true;
+        return (int)objects.size() - 1;
+    }
+
+    void setTransform(int object, const glm::mat4& model) {
+        SceneObject& o = objects[object];
+        if (o.model == model) return;
+        o.model = model;
+        bounds[object] = transformAabb(meshes[o.mesh].bounds, model);
+        moved_.push_back(object);
+    }
+
+    // 每帧渲染前调用：增删对象后重建 BVH，否则只 refit 本帧移动过的对象
+    void update() {
+        if (structureDirty_) { bvh.build(bounds); structureDirty_ = false; }
+        else for (int o : moved_) bvh.refit(o, bounds);
+        moved_.clear();
+    }
+
+    // 按相机 (VP) 与光源 (LVP) 视锥剔除，返回按对象编号升序的可见对象（绘制顺序与对象顺序一致）；内存来自帧内存
+    size_t collectVisible(const glm::mat4& VP, const glm::mat4& LVP, FrameArena& arena, VisibleObject*& out) {
+        glm::vec4 camPlanes[6], lightPlanes[6];
+        extractFrustumPlanes(VP, camPlanes); extractFrustumPlanes(LVP, lightPlanes);
+        if (visMask_.size() < objects.size()) visMask_.resize(objects.size(), 0);
+        int* list = arena.allocArray<int>(objects.size());
+        size_t n = 0;
+        bvh.cull(camPlanes, [&](int o) { if (!visMask_[o]) list[n++] = o; visMask_[o] |= 1; });
+        bvh.cull(lightPlanes, [&](int o) { if (!visMask_[o]) list[n++] = o; visMask_[o] |= 2; });
+        std::sort(list, list + n);
+        out = arena.allocArray<VisibleObject>(n);
+        for (size_t i = 0; i < n; ++i) {
+            int o = list[i];
+            out[i].object = o; out[i].inCam = (visMask_[o] & 1) != 0; out[i].inLight = (visMask_[o] & 2) != 0;
+            visMask_[o] = 0;
+        }
+        return n;
+    }
+
+private:
+    int addMeshLevel(std::vector<VertexIn> verts, std::vector<glm::ivec3> idx, float lodError, bool quantize) {
+        meshes.emplace_back();
+        SceneMesh& m = meshes.back();
+        m.verts = std::move(verts); m.lodError = lodError;
+        PosQuantization pq;
+        if (quantize) { pq = makePosQuantization(m.verts); snapPositions(m.verts, pq); }
+        buildMeshlets(m.verts, idx, m.meshlets);
+        if (quantize) {
+            m.qstreams.assign(m.verts, pq);
+            if (m.verts.size() <= kIndex16MaxVerts) { std::vector<Tri16> idx16; packIndices16(idx, idx16); m.idx16 = std::move(idx16); }
+        } else m.streams.assign(m.verts);
+        m.idx = std::move(idx);
+        for (const VertexIn& v : m.verts) m.bounds.grow(v.pos);
+        return (int)meshes.size() - 1;
+    }
+
+    std::vector<int> moved_;
+    std::vector<std::uint8_t> visMask_; // 遍历期间的可见标记，用完清零
+    bool structureDirty_ = false;
+};
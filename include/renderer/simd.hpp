@@ -0,0 +1,68 @@
+#pragma once
+// CPU 特性检测（CPUID）与 SIMD 目标属性；非 x86 平台只走标量路径
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define RENDERER_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define RENDERER_X86 0
+#endif
+
+// GCC/Clang 需逐函数开启指令集，其余代码仍按基础 x86-64 编译；MSVC 可直接使用 intrinsics
+#if RENDERER_X86 && !defined(_MSC_VER)
+#define RENDERER_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define RENDERER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define RENDERER_TARGET_SSE41
+#define RENDERER_TARGET_AVX2
+#endif
+
+enum class SimdLevel { Scalar, SSE41, AVX2 };
+
+static inline const char* simdLevelName(SimdLevel l) {
+    return l == SimdLevel::AVX2 ? "AVX2" : (l == SimdLevel::SSE41 ? "SSE4.1" : "Scalar");
+}
+
+// movemask 结果的置位数（不依赖 POPCNT 指令）
+static inline int popcountMask(unsigned m) {
+    int c = 0;
+    for (; m; m &= m - 1) ++c;
+    return c;
+}
+
+static inline SimdLevel detectSimdLevel() {
+#if RENDERER_X86
+    unsigned r1[4] = { 0, 0, 0, 0 }, r7[4] = { 0, 0, 0, 0 };
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0); unsigned maxLeaf = (unsigned)regs[0];
+    __cpuid(regs, 1); for (int i = 0; i < 4; ++i) r1[i] = (unsigned)regs[i];
+    if (maxLeaf >= 7) { __cpuidex(regs, 7, 0); for (int i = 0; i < 4; ++i) r7[i] = (unsigned)regs[i]; }
+#else
+    unsigned maxLeaf = __get_cpuid_max(0, nullptr);
+    __get_cpuid(1, &r1[0], &r1[1], &r1[2], &r1[3]);
+    if (maxLeaf >= 7) __get_cpuid_count(7, 0, &r7[0], &r7[1], &r7[2], &r7[3]);
+#endif
+    bool sse41 = (r1[2] & (1u << 19)) != 0;
+    bool osxsave = (r1[2] & (1u << 27)) != 0, avx = (r1[2] & (1u << 28)) != 0;
+    bool avx2 = (r7[1] & (1u << 5)) != 0;
+    if (avx && avx2 && osxsave) {
+        // 操作系统须保存 YMM 状态（XCR0 的 bit1/bit2）
+#ifdef _MSC_VER
+        std::uint64_t xcr0 = _xgetbv(0);
+#else
+        std::uint32_t lo, hi; __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        std::uint64_t xcr0 = ((std::uint64_t)hi << 32) | lo;
+#endif
+        if ((xcr0 & 6) == 6) return SimdLevel::AVX2;
+    }
+    if (sse41) return SimdLevel::SSE41;
+#endif
+    return SimdLevel::Scalar;
+}
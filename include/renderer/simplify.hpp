@@ -0,0 +1,328 @@
+#pragma once
+// 网格简化：二次误差度量（QEM）边折叠。按位置焊接后在位置图上折叠，折叠点取两端点中误差小的一个（不生成新顶点）。
+// UV/颜色接缝上的位置（同一位置有多组 UV/颜色）锁定不折叠，接缝不会被拉扯；
+// 被折叠角点改用目标位置上同一 UV/颜色、法线最接近的原顶点，法线不连续（硬边）的网格也能简化。
+// 简化结果的几何误差另由 meshDeviation 量（原网格位置到简化表面的最大距离）
+#include <vector>
+#include <queue>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include "mesh.hpp"
+#include "meshlet.hpp"
+
+static const double kBoundaryQuadricWeight = 10.0; // 开放边界的约束平面权重（相对面积权重）
+static const float kFlipMinCos = 0.2f;             // 折叠后相邻三角形法线与原法线夹角余弦下限，防止翻面
+static const size_t kDeviationCellsPerTri = 8;     // meshDeviation 的格子里每个三角形平均登记的格子数上限
+
+// 对称 4x4 二次型（上三角 10 项）+ 累计权重；Q(p) / w 为到各平面距离平方的加权平均，只用来排折叠顺序（不是距离上界）
+struct Quadric {
+    double a[10] = {};
+    double w = 0.0;
+    void addPlane(const glm::dvec3& n, double d, double weight) {
+        const double p[4] = { n.x, n.y, n.z, d };
+        int k = 0;
+        for (int i = 0; i < 4; ++i)
+            for (int j = i; j < 4; ++j) a[k++] += weight * p[i] * p[j];
+        w += weight;
+    }
+    void add(const Quadric& q) { for (int i = 0; i < 10; ++i) a[i] += q.a[i]; w += q.w; }
+    double eval(const glm::dvec3& v) const {
+        const double x = v.x, y = v.y, z = v.z;
+        return a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x
+            + a[4] * y * y + 2.0 * a[5] * y * z + 2.0 * a[6] * y
+            + a[7] * z * z + 2.0 * a[8] * z + a[9];
+    }
+};
+
+// 位置编号 + UV + 颜色按位比较（同一位置上区分接缝两侧）
+struct WedgeKey {
+    std::uint32_t bits[6];
+    bool operator==(const WedgeKey& o) const { return std::memcmp(bits, o.bits, sizeof(bits)) == 0; }
+};
+struct WedgeKeyHash {
+    size_t operator()(const WedgeKey& k) const { size_t h = 0; for (std::uint32_t b : k.bits) h = h * 0x9E3779B1u + b; return h; }
+};
+
+// 把 verts/idx 简化到不多于 targetTris 个三角形（锁定顶点过多时可能多于目标），结果写入 outVerts/outIdx（只含用到的原顶点）
+static inline void simplifyMesh(const std::vector<VertexIn>& verts, const std::vector<glm::ivec3>& idx, size_t targetTris,
+    std::vector<VertexIn>& outVerts, std::vector<glm::ivec3>& outIdx) {
+    const int nv = (int)verts.size();
+    // 按位置焊接；每个原顶点再按 (位置, UV, 颜色) 归入 wedge
+    std::vector<int> posId(nv), wedge(nv);
+    std::vector<glm::dvec3> P;
+    {
+        std::unordered_map<PosKey, int, PosKeyHash> ids; ids.reserve(nv);
+        for (int v = 0; v < nv; ++v) {
+            PosKey k; std::memcpy(k.bits, &verts[v].pos, sizeof(k.bits));
+            auto it = ids.emplace(k, (int)P.size());
+            if (it.second) P.push_back(glm::dvec3(verts[v].pos));
+            posId[v] = it.first->second;
+        }
+    }
+    const int np = (int)P.size(), nt = (int)idx.size();
+    std::vector<std::uint8_t> locked(np, 0);
+    std::vector<int> posStart(np + 1, 0), posVerts(nv); // 位置 -> 原顶点（CSR）
+    {
+        std::unordered_map<WedgeKey, int, WedgeKeyHash> ids; ids.reserve(nv);
+        std::vector<int> firstWedge(np, -1);
+        for (int v = 0; v < nv; ++v) {
+            WedgeKey k; k.bits[0] = (std::uint32_t)posId[v];
+            std::memcpy(k.bits + 1, &verts[v].uv, sizeof(float) * 2); std::memcpy(k.bits + 3, &verts[v].color, sizeof(float) * 3);
+            wedge[v] = ids.emplace(k, (int)ids.size()).first->second;
+            int& fw = firstWedge[posId[v]];
+            if (fw < 0) fw = wedge[v]; else if (fw != wedge[v]) locked[posId[v]] = 1;
+            ++posStart[posId[v] + 1];
+        }
+        for (int p = 0; p < np; ++p) posStart[p + 1] += posStart[p];
+        std::vector<int> fill(posStart.begin(), posStart.end() - 1);
+        for (int v = 0; v < nv; ++v) posVerts[fill[posId[v]]++] = v;
+    }
+    std::vector<glm::ivec3> tri(nt);      // 三角形的位置编号（折叠时改写）
+    std::vector<glm::ivec3> corner(idx);  // 三角形角点的原顶点编号（折叠时改写）
+    std::vector<std::uint8_t> triAlive(nt, 1);
+    std::vector<std::vector<int>> vtris(np); // 位置 -> 相邻三角形（含已删除的，遍历时跳过）
+    std::vector<Quadric> Q(np);
+    size_t alive = 0;
+    auto faceNormal = [&](const glm::ivec3& t) { return glm::cross(P[t.y] - P[t.x], P[t.z] - P[t.x]); };
+    for (int t = 0; t < nt; ++t) {
+        glm::ivec3 p(posId[idx[t].x], posId[idx[t].y], posId[idx[t].z]);
+        tri[t] = p;
+        if (p.x == p.y || p.y == p.z || p.x == p.z) { triAlive[t] = 0; continue; }
+        ++alive;
+        for (int k = 0; k < 3; ++k) vtris[p[k]].push_back(t);
+        glm::dvec3 n = faceNormal(p);
+        double len = glm::length(n);
+        if (len <= 0.0) continue;
+        n /= len;
+        for (int k = 0; k < 3; ++k) Q[p[k]].addPlane(n, -glm::dot(n, P[p.x]), len * 0.5);
+    }
+    // 开放边界：只属于一个三角形的边，加过该边且垂直于三角形的约束平面，避免边界向内收缩
+    {
+        std::unordered_map<std::uint64_t, int> edgeUse; edgeUse.reserve((size_t)alive * 3);
+        auto key = [](int a, int b) { return ((std::uint64_t)(std::uint32_t)std::min(a, b) << 32) | (std::uint32_t)std::max(a, b); };
+        for (int t = 0; t < nt; ++t) if (triAlive[t]) for (int k = 0; k < 3; ++k) ++edgeUse[key(tri[t][k], tri[t][(k + 1) % 3])];
+        for (int t = 0; t < nt; ++t) {
+            if (!triAlive[t]) continue;
+            glm::dvec3 fn = faceNormal(tri[t]);
+            if (glm::length(fn) <= 0.0) continue;
+            fn = glm::normalize(fn);
+            for (int k = 0; k < 3; ++k) {
+                int a = tri[t][k], b = tri[t][(k + 1) % 3];
+                if (edgeUse[key(a, b)] != 1) continue;
+                glm::dvec3 e = P[b] - P[a];
+                double len2 = glm::dot(e, e);
+                if (len2 <= 0.0) continue;
+                glm::dvec3 n = glm::normalize(glm::cross(e, fn));
+                Q[a].addPlane(n, -glm::dot(n, P[a]), kBoundaryQuadricWeight * len2);
+                Q[b].addPlane(n, -glm::dot(n, P[a]), kBoundaryQuadricWeight * len2);
+            }
+        }
+    }
+
+    // 边折叠候选：u -> v；版本号变化或端点已删除的候选作废
+    struct Candidate {
+        double cost; int u, v; std::uint32_t verU, verV;
+        bool operator>(const Candidate& o) const { return cost > o.cost; }
+    };
+    std::vector<std::uint32_t> version(np, 0);
+    std::vector<int> collapsedTo(np, -1);
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> heap;
+    auto errorOf = [&](int u, int v) { Quadric q = Q[u]; q.add(Q[v]); return std::max(0.0, q.eval(P[v])) / std::max(q.w, 1e-30); };
+    auto pushEdge = [&](int a, int b) { // 锁定的位置只能作为折叠目标
+        if (locked[a] && locked[b]) return;
+        double ab = locked[a] ? HUGE_VAL : errorOf(a, b), ba = locked[b] ? HUGE_VAL : errorOf(b, a);
+        if (ab <= ba) heap.push(Candidate{ ab, a, b, version[a], version[b] });
+        else heap.push(Candidate{ ba, b, a, version[b], version[a] });
+    };
+    for (int t = 0; t < nt; ++t)
+        if (triAlive[t])
+            for (int k = 0; k < 3; ++k) { int a = tri[t][k], b = tri[t][(k + 1) % 3]; if (a < b) pushEdge(a, b); }
+
+    // u 移到 v 后，u 的其它相邻三角形不能翻面或退化
+    auto flips = [&](int u, int v) {
+        for (int t : vtris[u]) {
+            if (!triAlive[t]) continue;
+            const glm::ivec3& p = tri[t];
+            if (p.x == v || p.y == v || p.z == v) continue; // 折叠后删除
+            glm::ivec3 q = p;
+            for (int k = 0; k < 3; ++k) if (q[k] == u) q[k] = v;
+            glm::dvec3 n0 = faceNormal(p), n1 = faceNormal(q);
+            double l0 = glm::length(n0), l1 = glm::length(n1);
+            if (l1 <= 0.0 || (l0 > 0.0 && glm::dot(n0, n1) < kFlipMinCos * l0 * l1)) return true;
+        }
+        return false;
+    };
+
+    // 位置 v 上属于 wedge w、法线与原顶点 a 最接近的原顶点
+    auto pickVertex = [&](int v, int w, int a) {
+        int best = -1; float bestDot = -2.0f;
+        for (int i = posStart[v]; i < posStart[v + 1]; ++i) {
+            int c = posVerts[i];
+            if (wedge[c] != w) continue;
+            float d = glm::dot(verts[c].normal, verts[a].normal);
+            if (d > bestDot) { bestDot = d; best = c; }
+        }
+        return best;
+    };
+
+    std::vector<int> ring;
+    while (alive > targetTris && !heap.empty()) {
+        Candidate c = heap.top(); heap.pop();
+        if (collapsedTo[c.u] >= 0 || collapsedTo[c.v] >= 0 || version[c.u] != c.verU || version[c.v] != c.verV) continue;
+        // u 未锁定，其角点同属一个 wedge；从被删除的三角形（同时含 u、v）取 v 一侧的 wedge
+        int wv = -1;
+        for (int t : vtris[c.u]) {
+            if (!triAlive[t]) continue;
+            for (int k = 0; k < 3; ++k) if (tri[t][k] == c.v) { wv = wedge[corner[t][k]]; break; }
+            if (wv >= 0) break;
+        }
+        if (wv < 0 || flips(c.u, c.v)) continue;
+        collapsedTo[c.u] = c.v;
+        Q[c.v].add(Q[c.u]);
+        ++version[c.v];
+        for (int t : vtris[c.u]) {
+            if (!triAlive[t]) continue;
+            glm::ivec3& p = tri[t];
+            if (p.x == c.v || p.y == c.v || p.z == c.v) { triAlive[t] = 0; --alive; continue; }
+            for (int k = 0; k < 3; ++k)
+                if (p[k] == c.u) { p[k] = c.v; corner[t][k] = pickVertex(c.v, wv, corner[t][k]); }
+            vtris[c.v].push_back(t);
+        }
+        std::vector<int>().swap(vtris[c.u]);
+        // 压缩 v 的三角形表，并重新评估 v 的所有边
+        ring.clear();
+        std::vector<int>& vt = vtris[c.v];
+        vt.erase(std::remove_if(vt.begin(), vt.end(), [&](int t) { return !triAlive[t]; }), vt.end());
+        for (int t : vt) for (int k = 0; k < 3; ++k) if (tri[t][k] != c.v) ring.push_back(tri[t][k]);
+        std::sort(ring.begin(), ring.end());
+        ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+        for (int w : ring) pushEdge(c.v, w); // 只有含 v 的边代价改变（v 的版本号已加一，旧候选作废）
+    }
+
+    // 输出剩余三角形用到的原顶点（按首次使用顺序）
+    std::vector<int> remap(nv, -1);
+    outVerts.clear(); outIdx.clear(); outIdx.reserve(alive);
+    for (int t = 0; t < nt; ++t) {
+        if (!triAlive[t]) continue;
+        glm::ivec3 o;
+        for (int k = 0; k < 3; ++k) {
+            int v = corner[t][k];
+            if (remap[v] < 0) { remap[v] = (int)outVerts.size(); outVerts.push_back(verts[v]); }
+            o[k] = remap[v];
+        }
+        outIdx.push_back(o);
+    }
+}
+
+// 点到三角形距离的平方（按最近点所在的 Voronoi 区域求）
+static inline double pointTriangleDistance2(const glm::dvec3& p, const glm::dvec3& a, const glm::dvec3& b, const glm::dvec3& c) {
+    auto dist2 = [&](const glm::dvec3& q) { glm::dvec3 e = p - q; return glm::dot(e, e); };
+    const glm::dvec3 ab = b - a, ac = c - a;
+    const double d1 = glm::dot(ab, p - a), d2 = glm::dot(ac, p - a);
+    if (d1 <= 0.0 && d2 <= 0.0) return dist2(a);
+    const double d3 = glm::dot(ab, p - b), d4 = glm::dot(ac, p - b);
+    if (d3 >= 0.0 && d4 <= d3) return dist2(b);
+    const double d5 = glm::dot(ab, p - c), d6 = glm::dot(ac, p - c);
+    if (d6 >= 0.0 && d5 <= d6) return dist2(c);
+    const double vc = d1 * d4 - d3 * d2, vb = d5 * d2 - d1 * d6, va = d3 * d6 - d5 * d4;
+    if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0 && d1 > d3) return dist2(a + ab * (d1 / (d1 - d3)));
+    if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0 && d2 > d6) return dist2(a + ac * (d2 / (d2 - d6)));
+    if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0 && d4 - d3 + d5 - d6 > 0.0) return dist2(b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6))));
+    const double sum = va + vb + vc;
+    if (sum <= 0.0) return std::min(dist2(a), std::min(dist2(b), dist2(c))); // 退化三角形（边长为 0 的边也落到这里）
+    return dist2(a + ab * (vb / sum) + ac * (vc / sum));
+}
+
+// 位置按 (x, y, z) 字典序比较
+static inline bool positionLess(const glm::vec3& a, const glm::vec3& b) {
+    return a.x < b.x || (a.x == b.x && (a.y < b.y || (a.y == b.y && a.z < b.z)));
+}
+
+// 网格的几何误差：points（原网格的位置）到 verts/idx 表面的最大距离（模型空间）；verts 中原样保留的位置距离为 0，不查。
+// 三角形按包围盒登记到均匀格子，每个点由近到远逐圈查格子，直到剩下的格子不可能更近或已近于当前最大值
+static inline float meshDeviation(const std::vector<glm::vec3>& points, const std::vector<VertexIn>& verts, const std::vector<glm::ivec3>& idx) {
+    if (points.empty() || idx.empty()) return 0.0f;
+    glm::dvec3 mn(HUGE_VAL), mx(-HUGE_VAL);
+    for (const VertexIn& v : verts) { mn = glm::min(mn, glm::dvec3(v.pos)); mx = glm::max(mx, glm::dvec3(v.pos)); }
+    // 格子边长：约每个三角形一个格子、三角形平均登记不超过 kDeviationCellsPerTri 个格子（大三角形多时格子放粗）
+    const glm::dvec3 ext = glm::max(mx - mn, glm::dvec3(1e-12));
+    double cell = std::max(ext.x, std::max(ext.y, ext.z)) / std::max(1.0, std::cbrt((double)idx.size()));
+    glm::ivec3 dim;
+    auto cellOf = [&](const glm::dvec3& p) { return glm::clamp(glm::ivec3(glm::floor((p - mn) / cell)), glm::ivec3(0), dim - 1); };
+    auto triCells = [&](size_t t, glm::ivec3& lo, glm::ivec3& hi) {
+        const glm::vec3 &a = verts[idx[t].x].pos, &b = verts[idx[t].y].pos, &c = verts[idx[t].z].pos;
+        lo = cellOf(glm::dvec3(glm::min(a, glm::min(b, c)))); hi = cellOf(glm::dvec3(glm::max(a, glm::max(b, c))));
+    };
+    size_t nitems = 0;
+    for (;; cell *= 1.25) {
+        dim = glm::ivec3(glm::floor(ext / cell)) + 1;
+        if ((double)dim.x * dim.y * dim.z > 2.0 * idx.size() + 8.0) continue;
+        nitems = 0;
+        for (size_t t = 0; t < idx.size(); ++t) {
+            glm::ivec3 lo, hi; triCells(t, lo, hi);
+            nitems += (size_t)(hi.x - lo.x + 1) * (hi.y - lo.y + 1) * (hi.z - lo.z + 1);
+        }
+        if (nitems <= kDeviationCellsPerTri * idx.size() || dim == glm::ivec3(1)) break;
+    }
+    auto cellIndex = [&](int x, int y, int z) { return ((size_t)z * dim.y + y) * dim.x + x; };
+    const size_t ncell = (size_t)dim.x * dim.y * dim.z;
+    std::vector<int> start(ncell + 1, 0), items(nitems);
+    for (int pass = 0; pass < 2; ++pass) { // 先计数，再填（CSR）
+        std::vector<int> fill;
+        if (pass) { for (size_t c = 0; c < ncell; ++c) start[c + 1] += start[c]; fill.assign(start.begin(), start.end() - 1); }
+        for (size_t t = 0; t < idx.size(); ++t) {
+            glm::ivec3 lo, hi; triCells(t, lo, hi);
+            for (int z = lo.z; z <= hi.z; ++z)
+                for (int y = lo.y; y <= hi.y; ++y)
+                    for (int x = lo.x; x <= hi.x; ++x) {
+                        if (pass) items[fill[cellIndex(x, y, z)]++] = (int)t;
+                        else ++start[cellIndex(x, y, z) + 1];
+                    }
+        }
+    }
+    std::vector<glm::vec3> kept(verts.size());
+    for (size_t v = 0; v < verts.size(); ++v) kept[v] = verts[v].pos;
+    std::sort(kept.begin(), kept.end(), positionLess);
+    std::vector<std::uint32_t> seen(idx.size(), 0); // 三角形可能登记在多个格子，按查询编号去重
+    std::uint32_t query = 0;
+    double maxDist2 = 0.0;
+    for (const glm::vec3& pf : points) {
+        if (std::binary_search(kept.begin(), kept.end(), pf, positionLess)) continue;
+        const glm::dvec3 p(pf);
+        const glm::ivec3 c = cellOf(p);
+        ++query;
+        double best = HUGE_VAL;
+        // 查过 0..r-1 圈后，没见过的三角形都在这些格子围成的盒子之外，离 p 至少为 p 到盒子各面（格子边界以外还有格子的面）的最短距离
+        auto reach = [&](int r) {
+            double g = HUGE_VAL;
+            for (int k = 0; k < 3; ++k) {
+                if (c[k] - r + 1 > 0) g = std::min(g, p[k] - (mn[k] + (c[k] - r + 1) * cell));
+                if (c[k] + r < dim[k]) g = std::min(g, mn[k] + (c[k] + r) * cell - p[k]);
+            }
+            return g;
+        };
+        // 只求最大值：找到比当前最大值还近的三角形后这个点不用再查
+        for (int r = 0; best > maxDist2; ++r) {
+            if (r > 0) { const double g = reach(r); if (g == HUGE_VAL || (g > 0.0 && best <= g * g)) break; }
+            const glm::ivec3 lo = glm::max(c - r, glm::ivec3(0)), hi = glm::min(c + r, dim - 1);
+            for (int z = lo.z; z <= hi.z; ++z)
+                for (int y = lo.y; y <= hi.y; ++y)
+                    for (int x = lo.x; x <= hi.x; ++x) {
+                        if (std::abs(x - c.x) != r && std::abs(y - c.y) != r && std::abs(z - c.z) != r) continue; // 只查这一圈
+                        const size_t ci = cellIndex(x, y, z);
+                        for (int i = start[ci]; i < start[ci + 1] && best > maxDist2; ++i) {
+                            const int t = items[i];
+                            if (seen[t] == query) continue;
+                            seen[t] = query;
+                            best = std::min(best, pointTriangleDistance2(p, glm::dvec3(verts[idx[t].x].pos), glm::dvec3(verts[idx[t].y].pos), glm::dvec3(verts[idx[t].z].pos)));
+                        }
+                    }
+        }
+        maxDist2 = std::max(maxDist2, best);
+    }
+    return (float)std::sqrt(maxDist2);
+}
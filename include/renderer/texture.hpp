@@ -1,5 +1,5 @@
 #pragma once
-// 2D 8bit RGBA֧/˫Բ
+// 2D 纹理（8bit RGBA），支持最近点/双线性采样
 #include <stb_image.h>
 #include <vector>
 #include <glm/glm.hpp>
@@ -8,7 +8,7 @@ struct Texture2D {
     int w = 0, h = 0, c = 4; // RGBA
     std::vector<unsigned char> data; // 8bit RGBA
 
-    bool load(const char* path); //  src/texture.cpp ʵ
+    bool load(const char* path); // 在 src/texture.cpp 中实现
 
     void makeChecker(int W = 512, int H = 512, int grid = 16) {
         w = W; h = H; c = 4; data.resize((size_t)w * h * 4);
@@ -22,7 +22,7 @@ struct Texture2D {
                 p[0] = v; p[1] = v; p[2] = v; p[3] = 255;
             }
         }
-        // UV ο
+        // UV 参考线
         for (int x = 0; x < w; ++x) {
             int y = h / 2; unsigned char* p = &data[(y * w + x) * 4];
             p[0] = 255; p[1] = 64; p[2] = 64; p[3] = 255;
@@ -0,0 +1,100 @@
+#pragma once
+// 常驻线程池：parallelFor 把 [0, count) 的任务分给所有核心（调用线程也参与）
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads = 0) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 1; i < threads; ++i) workers_.emplace_back([this, i] { workerLoop((int)i); });
+    }
+    ~ThreadPool() {
+        { std::lock_guard<std::mutex> lk(mtx_); quit_ = true; }
+        cv_.notify_all();
+        for (auto& t : workers_) t.join();
+    }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // 参与执行的线程数（含调用线程）
+    int size() const { return (int)workers_.size() + 1; }
+
+    // serial = true 时全部任务在调用线程上按顺序执行，便于与并行结果对比
+    void setSerial(bool s) { serial_ = s; }
+    bool serial() const { return serial_; }
+
+    // fn(taskIndex, workerIndex)；workerIndex ∈ [0, size())，0 为调用线程
+    template<typename F>
+    void parallelFor(int count, F&& fn) {
+        if (count <= 0) return;
+        if (serial_ || workers_.empty() || count == 1) { for (int i = 0; i < count; ++i) fn(i, 0); return; }
+        using Fn = typename std::remove_reference<F>::type;
+        run(count, [](void* ctx, int task, int worker) { (*static_cast<Fn*>(ctx))(task, worker); }, (void*)&fn);
+    }
+
+    // 把 [0, n) 切成 grain 大小的块并行处理：fn(begin, end, workerIndex)
+    template<typename F>
+    void parallelRange(size_t n, size_t grain, F&& fn) {
+        int blocks = (int)((n + grain - 1) / grain);
+        parallelFor(blocks, [&](int b, int worker) { fn((size_t)b * grain, std::min(n, (size_t)(b + 1) * grain), worker); });
+    }
+
+private:
+    typedef void (*TaskFn)(void*, int, int);
+
+    void run(int count, TaskFn fn, void* ctx) {
+        {
+            std::lock_guard<std::mutex> lk(mtx_);
+            fn_ = fn; ctx_ = ctx; count_ = count;
+            next_.store(0); pending_.store((int)workers_.size());
+            ++generation_;
+        }
+        cv_.notify_all();
+        drain(0);
+        // 等待所有工作线程离开本轮任务，之后 fn/ctx 才能失效
+        std::unique_lock<std::mutex> lk(mtx_);
+        doneCv_.wait(lk, [this] { return pending_.load() == 0; });
+    }
+
+    void drain(int worker) {
+        for (;;) {
+            int i = next_.fetch_add(1);
+            if (i >= count_) break;
+            fn_(ctx_, i, worker);
+        }
+    }
+
+    void workerLoop(int worker) {
+        std::uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lk(mtx_);
+                cv_.wait(lk, [&] { return quit_ || generation_ != seen; });
+                if (quit_) return;
+                seen = generation_;
+            }
+            drain(worker);
+            if (pending_.fetch_sub(1) == 1) { std::lock_guard<std::mutex> lk(mtx_); doneCv_.notify_one(); }
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex mtx_;
+    std::condition_variable cv_, doneCv_;
+    std::uint64_t generation_ = 0;
+    bool quit_ = false;
+    bool serial_ = false;
+
+    TaskFn fn_ = nullptr;
+    void* ctx_ = nullptr;
+    int count_ = 0;
+    std::atomic<int> next_{ 0 };
+    std::atomic<int> pending_{ 0 };
+};
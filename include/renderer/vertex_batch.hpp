@@ -0,0 +1,470 @@
+#pragma once
+// 批处理顶点阶段：SoA 输入（浮点 VertexStreams 或压缩的 QuantizedStreams），一次变换 4/8 个顶点（标量 / SSE4.1 / AVX2），
+// 输出紧凑的 VertexOut / ShadowVOut。各版本运算顺序完全一致，输出逐位相同
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "simd.hpp"
+#include "raster_row.hpp"
+#include "mesh.hpp"
+#include "quantize.hpp"
+#include "pipeline.hpp"
+#include "common.hpp"
+
+// 点变换（w = 1），固定的求和顺序：(m0 * x + m1 * y) + (m2 * z + m3)
+static inline glm::vec4 xformPoint(const glm::mat4& m, float x, float y, float z) {
+    glm::vec4 r;
+    for (int k = 0; k < 4; ++k) r[k] = (m[0][k] * x + m[1][k] * y) + (m[2][k] * z + m[3][k]);
+    return r;
+}
+
+// 定点屏幕坐标：与 ndcToScreenFx 相同的运算，舍入为 lround（半数远离 0）
+static inline glm::ivec2 clipToScreenFx(const glm::vec4& clip, float invW, int W, int H) {
+    return ndcToScreenFx(glm::vec3(clip) * invW, W, H);
+}
+
+// 顶点输入取数：VertexStreams 直接读浮点；QuantizedStreams 在这里解码（位置反量化、八面体法线、半精度 uv、RGB8 颜色）。
+// SIMD 解码（load*SSE41 / load*AVX2）按同样的运算顺序，结果逐位相同
+static inline glm::vec3 fetchPos(const VertexStreams& in, size_t i) { return glm::vec3(in.px[i], in.py[i], in.pz[i]); }
+static inline glm::vec3 fetchNormal(const VertexStreams& in, size_t i) { return glm::vec3(in.nx[i], in.ny[i], in.nz[i]); }
+static inline glm::vec3 fetchColor(const VertexStreams& in, size_t i) { return glm::vec3(in.r[i], in.g[i], in.b[i]); }
+static inline glm::vec2 fetchUV(const VertexStreams& in, size_t i) { return glm::vec2(in.u[i], in.v[i]); }
+
+static inline glm::vec3 fetchPos(const QuantizedStreams& in, size_t i) {
+    return glm::vec3(in.pos.decode(in.px[i], 0), in.pos.decode(in.py[i], 1), in.pos.decode(in.pz[i], 2));
+}
+static inline glm::vec3 fetchNormal(const QuantizedStreams& in, size_t i) { return octDecode(in.ox[i], in.oy[i]); }
+static inline glm::vec3 fetchColor(const QuantizedStreams& in, size_t i) {
+    if (in.rgb.empty()) return in.color;
+    std::uint32_t c = in.rgb[i];
+    return glm::vec3((float)(c & 255u), (float)((c >> 8) & 255u), (float)((c >> 16) & 255u)) * (1.0f / 255.0f);
+}
+static inline glm::vec2 fetchUV(const QuantizedStreams& in, size_t i) { return glm::vec2(halfToFloat(in.u[i]), halfToFloat(in.v[i])); }
+
+// [b, e) 内的顶点写到 out[b, e)。light 非空时 lightClip 直接取 light[i].clip（阴影通道已算好，二者都是 LM * pos），不再用 xf.LM
+template<typename In> using VertexBatchFn = void (*)(const In& in, size_t b, size_t e, const VertexXform& xf, const ShadowVOut* light, VertexOut* out);
+template<typename In> using ShadowBatchFn = void (*)(const In& in, size_t b, size_t e, const VertexXform& xf, ShadowVOut* out);
+
+template<typename In>
+static inline void vertexBatchScalar(const In& in, size_t b, size_t e, const VertexXform& xf, const ShadowVOut* light, VertexOut* out) {
+    const glm::mat3& N = xf.normalMat;
+    for (size_t i = b; i < e; ++i) {
+        VertexOut& o = out[i];
+        glm::vec3 p = fetchPos(in, i), nm = fetchNormal(in, i);
+        o.clip = xformPoint(xf.MVP, p.x, p.y, p.z);
+        o.invW = 1.0f / o.clip.w;
+        o.screen = clipToScreenFx(o.clip, o.invW, xf.W, xf.H);
+        o.depth01 = o.clip.z * o.invW;
+        o.lightClip = light ? light[i].clip : xformPoint(xf.LM, p.x, p.y, p.z);
+        glm::vec3 n;
+        for (int k = 0; k < 3; ++k) n[k] = (N[0][k] * nm.x + N[1][k] * nm.y) + N[2][k] * nm.z;
+        float invLen = 1.0f / std::sqrt((n.x * n.x + n.y * n.y) + n.z * n.z);
+        o.normal = n * invLen;
+        o.color = fetchColor(in, i);
+        o.uv = fetchUV(in, i);
+    }
+}
+
+template<typename In>
+static inline void shadowBatchScalar(const In& in, size_t b, size_t e, const VertexXform& xf, ShadowVOut* out) {
+    for (size_t i = b; i < e; ++i) {
+        ShadowVOut& o = out[i];
+        glm::vec3 p = fetchPos(in, i);
+        o.clip = xformPoint(xf.MVP, p.x, p.y, p.z);
+        o.invW = 1.0f / o.clip.w;
+        o.screen = clipToScreenFx(o.clip, o.invW, xf.W, xf.H);
+        o.depth01 = o.clip.z * o.invW;
+    }
+}
+
+#if RENDERER_X86
+// 每个矩阵元素广播成一个向量，下标 col * 4 + row
+RENDERER_TARGET_SSE41
+static inline void splatMat4SSE41(const glm::mat4& m, __m128* s) {
+    for (int c = 0; c < 4; ++c) for (int r = 0; r < 4; ++r) s[c * 4 + r] = _mm_set1_ps(m[c][r]);
+}
+
+RENDERER_TARGET_SSE41
+static inline __m128 xformRowSSE41(const __m128* m, int r, __m128 x, __m128 y, __m128 z) {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[r], x), _mm_mul_ps(m[4 + r], y)), _mm_add_ps(_mm_mul_ps(m[8 + r], z), m[12 + r]));
+}
+
+// NDC -> 定点屏幕坐标，舍入同 lround：先截断，余数绝对值 >= 0.5 时远离 0 进一
+RENDERER_TARGET_SSE41
+static inline __m128i screenFxSSE41(__m128 ndc, __m128 scale, bool flipY) {
+    const __m128 half = _mm_set1_ps(0.5f), one = _mm_set1_ps(1.0f), lim = _mm_set1_ps(kMaxScreenFx);
+    __m128 t = _mm_add_ps(_mm_mul_ps(ndc, half), half);
+    if (flipY) t = _mm_sub_ps(one, t);
+    __m128 s = _mm_mul_ps(_mm_mul_ps(t, scale), _mm_set1_ps(float(kSubPixelScale)));
+    s = _mm_min_ps(_mm_max_ps(s, _mm_sub_ps(_mm_setzero_ps(), lim)), lim);
+    __m128 tr = _mm_round_ps(s, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC), d = _mm_sub_ps(s, tr);
+    __m128 up = _mm_and_ps(_mm_cmpge_ps(d, half), one), down = _mm_and_ps(_mm_cmple_ps(d, _mm_sub_ps(_mm_setzero_ps(), half)), one);
+    return _mm_cvttps_epi32(_mm_sub_ps(_mm_add_ps(tr, up), down));
+}
+
+RENDERER_TARGET_SSE41
+static inline void loadPosSSE41(const VertexStreams& in, size_t i, __m128& x, __m128& y, __m128& z) {
+    x = _mm_loadu_ps(&in.px[i]); y = _mm_loadu_ps(&in.py[i]); z = _mm_loadu_ps(&in.pz[i]);
+}
+
+RENDERER_TARGET_SSE41
+static inline void loadNormalSSE41(const VertexStreams& in, size_t i, __m128& x, __m128& y, __m128& z) {
+    x = _mm_loadu_ps(&in.nx[i]); y = _mm_loadu_ps(&in.ny[i]); z = _mm_loadu_ps(&in.nz[i]);
+}
+
+// 4 个 16 位整数 -> float
+RENDERER_TARGET_SSE41
+static inline __m128 loadU16SSE41(const std::uint16_t* p) { return _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)p))); }
+RENDERER_TARGET_SSE41
+static inline __m128 loadI16SSE41(const std::int16_t* p) { return _mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i*)p))); }
+
+RENDERER_TARGET_SSE41
+static inline void loadPosSSE41(const QuantizedStreams& in, size_t i, __m128& x, __m128& y, __m128& z) {
+    const PosQuantization& q = in.pos;
+    x = _mm_add_ps(_mm_mul_ps(loadU16SSE41(&in.px[i]), _mm_set1_ps(q.scale.x)), _mm_set1_ps(q.offset.x));
+    y = _mm_add_ps(_mm_mul_ps(loadU16SSE41(&in.py[i]), _mm_set1_ps(q.scale.y)), _mm_set1_ps(q.offset.y));
+    z = _mm_add_ps(_mm_mul_ps(loadU16SSE41(&in.pz[i]), _mm_set1_ps(q.scale.z)), _mm_set1_ps(q.offset.z));
+}
+
+// 八面体解码（同 octDecode）：z < 0 的一侧按符号折回
+RENDERER_TARGET_SSE41
+static inline void loadNormalSSE41(const QuantizedStreams& in, size_t i, __m128& x, __m128& y, __m128& z) {
+    const __m128 k = _mm_set1_ps(1.0f / kOctScale), one = _mm_set1_ps(1.0f), sign = _mm_set1_ps(-0.0f);
+    __m128 ux = _mm_mul_ps(loadI16SSE41(&in.ox[i]), k), uy = _mm_mul_ps(loadI16SSE41(&in.oy[i]), k);
+    __m128 ax = _mm_andnot_ps(sign, ux), ay = _mm_andnot_ps(sign, uy);
+    z = _mm_sub_ps(_mm_sub_ps(one, ax), ay);
+    __m128 fold = _mm_cmplt_ps(z, _mm_setzero_ps());
+    x = _mm_blendv_ps(ux, _mm_or_ps(_mm_sub_ps(one, ay), _mm_and_ps(sign, ux)), fold);
+    y = _mm_blendv_ps(uy, _mm_or_ps(_mm_sub_ps(one, ax), _mm_and_ps(sign, uy)), fold);
+}
+
+RENDERER_TARGET_SSE41
+static inline void loadUVSSE41(const VertexStreams& in, size_t i, __m128& u, __m128& v) { u = _mm_loadu_ps(&in.u[i]); v = _mm_loadu_ps(&in.v[i]); }
+
+// 半精度 -> float（同 halfToFloat，转换是精确的）：指数与尾数左移 13 位后乘 2^112，非规格化数同样成立；无穷 / NaN 单独处理
+RENDERER_TARGET_SSE41
+static inline __m128 halfToFloatSSE41(const std::uint16_t* p) {
+    __m128i h = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)p));
+    __m128i em = _mm_and_si128(h, _mm_set1_epi32(0x7fff)), sh = _mm_slli_epi32(em, 13);
+    __m128 f = _mm_mul_ps(_mm_castsi128_ps(sh), _mm_castsi128_ps(_mm_set1_epi32(0x77800000)));
+    __m128 special = _mm_castsi128_ps(_mm_cmpgt_epi32(em, _mm_set1_epi32(0x7bff)));
+    f = _mm_blendv_ps(f, _mm_castsi128_ps(_mm_or_si128(sh, _mm_set1_epi32(0x70000000))), special);
+    return _mm_or_ps(f, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16)));
+}
+
+RENDERER_TARGET_SSE41
+static inline void loadUVSSE41(const QuantizedStreams& in, size_t i, __m128& u, __m128& v) { u = halfToFloatSSE41(&in.u[i]); v = halfToFloatSSE41(&in.v[i]); }
+
+template<typename In>
+RENDERER_TARGET_SSE41
+static void vertexBatchSSE41(const In& in, size_t b, size_t e, const VertexXform& xf, const ShadowVOut* light, VertexOut* out) {
+    __m128 mvp[16], lm[16], nm[9];
+    splatMat4SSE41(xf.MVP, mvp); splatMat4SSE41(xf.LM, lm);
+    for (int c = 0; c < 3; ++c) for (int r = 0; r < 3; ++r) nm[c * 3 + r] = _mm_set1_ps(xf.normalMat[c][r]);
+    const __m128 one = _mm_set1_ps(1.0f), sw = _mm_set1_ps(float(xf.W - 1)), sh = _mm_set1_ps(float(xf.H - 1));
+    alignas(16) float C[4][4], L[4][4], Nn[3][4], Z[4], IW[4], U[4], V[4]; alignas(16) int SX[4], SY[4];
+    size_t i = b;
+    for (; i + 4 <= e; i += 4) {
+        __m128 x, y, z; loadPosSSE41(in, i, x, y, z);
+        __m128 c[4];
+        for (int r = 0; r < 4; ++r) { c[r] = xformRowSSE41(mvp, r, x, y, z); _mm_store_ps(C[r], c[r]); }
+        if (!light) for (int r = 0; r < 4; ++r) _mm_store_ps(L[r], xformRowSSE41(lm, r, x, y, z));
+        __m128 iw = _mm_div_ps(one, c[3]);
+        _mm_store_ps(IW, iw);
+        _mm_store_ps(Z, _mm_mul_ps(c[2], iw));
+        _mm_store_si128((__m128i*)SX, screenFxSSE41(_mm_mul_ps(c[0], iw), sw, false));
+        _mm_store_si128((__m128i*)SY, screenFxSSE41(_mm_mul_ps(c[1], iw), sh, true));
+        __m128 nx, ny, nz, n[3]; loadNormalSSE41(in, i, nx, ny, nz);
+        for (int r = 0; r < 3; ++r) n[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nm[r], nx), _mm_mul_ps(nm[3 + r], ny)), _mm_mul_ps(nm[6 + r], nz));
+        __m128 invLen = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(n[0], n[0]), _mm_mul_ps(n[1], n[1])), _mm_mul_ps(n[2], n[2]))));
+        for (int r = 0; r < 3; ++r) _mm_store_ps(Nn[r], _mm_mul_ps(n[r], invLen));
+        __m128 u, v; loadUVSSE41(in, i, u, v);
+        _mm_store_ps(U, u); _mm_store_ps(V, v);
+        for (int l = 0; l < 4; ++l) {
+            VertexOut& o = out[i + l];
+            o.clip = glm::vec4(C[0][l], C[1][l], C[2][l], C[3][l]);
+            o.screen = glm::ivec2(SX[l], SY[l]);
+            o.depth01 = Z[l]; o.invW = IW[l];
+            o.color = fetchColor(in, i + l);
+            o.uv = glm::vec2(U[l], V[l]);
+            o.normal = glm::vec3(Nn[0][l], Nn[1][l], Nn[2][l]);
+            o.lightClip = light ? light[i + l].clip : glm::vec4(L[0][l], L[1][l], L[2][l], L[3][l]);
+        }
+    }
+    vertexBatchScalar(in, i, e, xf, light, out);
+}
+
+template<typename In>
+RENDERER_TARGET_SSE41
+static void shadowBatchSSE41(const In& in, size_t b, size_t e, const VertexXform& xf, ShadowVOut* out) {
+    __m128 mvp[16]; splatMat4SSE41(xf.MVP, mvp);
+    const __m128 one = _mm_set1_ps(1.0f), sw = _mm_set1_ps(float(xf.W - 1)), sh = _mm_set1_ps(float(xf.H - 1));
+    alignas(16) float C[4][4], Z[4], IW[4]; alignas(16) int SX[4], SY[4];
+    size_t i = b;
+    for (; i + 4 <= e; i += 4) {
+        __m128 x, y, z; loadPosSSE41(in, i, x, y, z);
+        __m128 c[4];
+        for (int r = 0; r < 4; ++r) { c[r] = xformRowSSE41(mvp, r, x, y, z); _mm_store_ps(C[r], c[r]); }
+        __m128 iw = _mm_div_ps(one, c[3]);
+        _mm_store_ps(IW, iw);
+        _mm_store_ps(Z, _mm_mul_ps(c[2], iw));
+        _mm_store_si128((__m128i*)SX, screenFxSSE41(_mm_mul_ps(c[0], iw), sw, false));
+        _mm_store_si128((__m128i*)SY, screenFxSSE41(_mm_mul_ps(c[1], iw), sh, true));
+        for (int l = 0; l < 4; ++l) {
+            ShadowVOut& o = out[i + l];
+            o.clip = glm::vec4(C[0][l], C[1][l], C[2][l], C[3][l]);
+            o.screen = glm::ivec2(SX[l], SY[l]);
+            o.depth01 = Z[l]; o.invW = IW[l];
+        }
+    }
+    shadowBatchScalar(in, i, e, xf, out);
+}
+
+RENDERER_TARGET_AVX2
+static inline void splatMat4AVX2(const glm::mat4& m, __m256* s) {
+    for (int c = 0; c < 4; ++c) for (int r = 0; r < 4; ++r) s[c * 4 + r] = _mm256_set1_ps(m[c][r]);
+}
+
+RENDERER_TARGET_AVX2
+static inline __m256 xformRowAVX2(const __m256* m, int r, __m256 x, __m256 y, __m256 z) {
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[r], x), _mm256_mul_ps(m[4 + r], y)), _mm256_add_ps(_mm256_mul_ps(m[8 + r], z), m[12 + r]));
+}
+
+RENDERER_TARGET_AVX2
+static inline __m256i screenFxAVX2(__m256 ndc, __m256 scale, bool flipY) {
+    const __m256 half = _mm256_set1_ps(0.5f), one = _mm256_set1_ps(1.0f), lim = _mm256_set1_ps(kMaxScreenFx);
+    __m256 t = _mm256_add_ps(_mm256_mul_ps(ndc, half), half);
+    if (flipY) t = _mm256_sub_ps(one, t);
+    __m256 s = _mm256_mul_ps(_mm256_mul_ps(t, scale), _mm256_set1_ps(float(kSubPixelScale)));
+    s = _mm256_min_ps(_mm256_max_ps(s, _mm256_sub_ps(_mm256_setzero_ps(), lim)), lim);
+    __m256 tr = _mm256_round_ps(s, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC), d = _mm256_sub_ps(s, tr);
+    __m256 up = _mm256_and_ps(_mm256_cmp_ps(d, half, _CMP_GE_OQ), one);
+    __m256 down = _mm256_and_ps(_mm256_cmp_ps(d, _mm256_sub_ps(_mm256_setzero_ps(), half), _CMP_LE_OQ), one);
+    return _mm256_cvttps_epi32(_mm256_sub_ps(_mm256_add_ps(tr, up), down));
+}
+
+RENDERER_TARGET_AVX2
+static inline void loadPosAVX2(const VertexStreams& in, size_t i, __m256& x, __m256& y, __m256& z) {
+    x = _mm256_loadu_ps(&in.px[i]); y = _mm256_loadu_ps(&in.py[i]); z = _mm256_loadu_ps(&in.pz[i]);
+}
+
+RENDERER_TARGET_AVX2
+static inline void loadNormalAVX2(const VertexStreams& in, size_t i, __m256& x, __m256& y, __m256& z) {
+    x = _mm256_loadu_ps(&in.nx[i]); y = _mm256_loadu_ps(&in.ny[i]); z = _mm256_loadu_ps(&in.nz[i]);
+}
+
+RENDERER_TARGET_AVX2
+static inline __m256 loadU16AVX2(const std::uint16_t* p) { return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p))); }
+RENDERER_TARGET_AVX2
+static inline __m256 loadI16AVX2(const std::int16_t* p) { return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)p))); }
+
+RENDERER_TARGET_AVX2
+static inline void loadPosAVX2(const QuantizedStreams& in, size_t i, __m256& x, __m256& y, __m256& z) {
+    const PosQuantization& q = in.pos;
+    x = _mm256_add_ps(_mm256_mul_ps(loadU16AVX2(&in.px[i]), _mm256_set1_ps(q.scale.x)), _mm256_set1_ps(q.offset.x));
+    y = _mm256_add_ps(_mm256_mul_ps(loadU16AVX2(&in.py[i]), _mm256_set1_ps(q.scale.y)), _mm256_set1_ps(q.offset.y));
+    z = _mm256_add_ps(_mm256_mul_ps(loadU16AVX2(&in.pz[i]), _mm256_set1_ps(q.scale.z)), _mm256_set1_ps(q.offset.z));
+}
+
+RENDERER_TARGET_AVX2
+static inline void loadNormalAVX2(const QuantizedStreams& in, size_t i, __m256& x, __m256& y, __m256& z) {
+    const __m256 k = _mm256_set1_ps(1.0f / kOctScale), one = _mm256_set1_ps(1.0f), sign = _mm256_set1_ps(-0.0f);
+    __m256 ux = _mm256_mul_ps(loadI16AVX2(&in.ox[i]), k), uy = _mm256_mul_ps(loadI16AVX2(&in.oy[i]), k);
+    __m256 ax = _mm256_andnot_ps(sign, ux), ay = _mm256_andnot_ps(sign, uy);
+    z = _mm256_sub_ps(_mm256_sub_ps(one, ax), ay);
+    __m256 fold = _mm256_cmp_ps(z, _mm256_setzero_ps(), _CMP_LT_OQ);
+    x = _mm256_blendv_ps(ux, _mm256_or_ps(_mm256_sub_ps(one, ay), _mm256_and_ps(sign, ux)), fold);
+    y = _mm256_blendv_ps(uy, _mm256_or_ps(_mm256_sub_ps(one, ax), _mm256_and_ps(sign, uy)), fold);
+}
+
+RENDERER_TARGET_AVX2
+static inline void loadUVAVX2(const VertexStreams& in, size_t i, __m256& u, __m256& v) { u = _mm256_loadu_ps(&in.u[i]); v = _mm256_loadu_ps(&in.v[i]); }
+
+RENDERER_TARGET_AVX2
+static inline __m256 halfToFloatAVX2(const std::uint16_t* p) {
+    __m256i h = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p));
+    __m256i em = _mm256_and_si256(h, _mm256_set1_epi32(0x7fff)), sh = _mm256_slli_epi32(em, 13);
+    __m256 f = _mm256_mul_ps(_mm256_castsi256_ps(sh), _mm256_castsi256_ps(_mm256_set1_epi32(0x77800000)));
+    __m256 special = _mm256_castsi256_ps(_mm256_cmpgt_epi32(em, _mm256_set1_epi32(0x7bff)));
+    f = _mm256_blendv_ps(f, _mm256_castsi256_ps(_mm256_or_si256(sh, _mm256_set1_epi32(0x70000000))), special);
+    return _mm256_or_ps(f, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(0x8000)), 16)));
+}
+
+RENDERER_TARGET_AVX2
+static inline void loadUVAVX2(const QuantizedStreams& in, size_t i, __m256& u, __m256& v) { u = halfToFloatAVX2(&in.u[i]); v = halfToFloatAVX2(&in.v[i]); }
+
+template<typename In>
+RENDERER_TARGET_AVX2
+static void vertexBatchAVX2(const In& in, size_t b, size_t e, const VertexXform& xf, const ShadowVOut* light, VertexOut* out) {
+    __m256 mvp[16], lm[16], nm[9];
+    splatMat4AVX2(xf.MVP, mvp); splatMat4AVX2(xf.LM, lm);
+    for (int c = 0; c < 3; ++c) for (int r = 0; r < 3; ++r) nm[c * 3 + r] = _mm256_set1_ps(xf.normalMat[c][r]);
+    const __m256 one = _mm256_set1_ps(1.0f), sw = _mm256_set1_ps(float(xf.W - 1)), sh = _mm256_set1_ps(float(xf.H - 1));
+    alignas(32) float C[4][8], L[4][8], Nn[3][8], Z[8], IW[8], U[8], V[8]; alignas(32) int SX[8], SY[8];
+    size_t i = b;
+    for (; i + 8 <= e; i += 8) {
+        __m256 x, y, z; loadPosAVX2(in, i, x, y, z);
+        __m256 c[4];
+        for (int r = 0; r < 4; ++r) { c[r] = xformRowAVX2(mvp, r, x, y, z); _mm256_store_ps(C[r], c[r]); }
+        if (!light) for (int r = 0; r < 4; ++r) _mm256_store_ps(L[r], xformRowAVX2(lm, r, x, y, z));
+        __m256 iw = _mm256_div_ps(one, c[3]);
+        _mm256_store_ps(IW, iw);
+        _mm256_store_ps(Z, _mm256_mul_ps(c[2], iw));
+        _mm256_store_si256((__m256i*)SX, screenFxAVX2(_mm256_mul_ps(c[0], iw), sw, false));
+        _mm256_store_si256((__m256i*)SY, screenFxAVX2(_mm256_mul_ps(c[1], iw), sh, true));
+        __m256 nx, ny, nz, n[3]; loadNormalAVX2(in, i, nx, ny, nz);
+        for (int r = 0; r < 3; ++r) n[r] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nm[r], nx), _mm256_mul_ps(nm[3 + r], ny)), _mm256_mul_ps(nm[6 + r], nz));
+        __m256 invLen = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(n[0], n[0]), _mm256_mul_ps(n[1], n[1])), _mm256_mul_ps(n[2], n[2]))));
+        for (int r = 0; r < 3; ++r) _mm256_store_ps(Nn[r], _mm256_mul_ps(n[r], invLen));
+        __m256 u, v; loadUVAVX2(in, i, u, v);
+        _mm256_store_ps(U, u); _mm256_store_ps(V, v);
+        for (int l = 0; l < 8; ++l) {
+            VertexOut& o = out[i + l];
+            o.clip = glm::vec4(C[0][l], C[1][l], C[2][l], C[3][l]);
+            o.screen = glm::ivec2(SX[l], SY[l]);
+            o.depth01 = Z[l]; o.invW = IW[l];
+            o.color = fetchColor(in, i + l);
+            o.uv = glm::vec2(U[l], V[l]);
+            o.normal = glm::vec3(Nn[0][l], Nn[1][l], Nn[2][l]);
+            o.lightClip = light ? light[i + l].clip : glm::vec4(L[0][l], L[1][l], L[2][l], L[3][l]);
+        }
+    }
+    vertexBatchScalar(in, i, e, xf, light, out);
+}
+
+template<typename In>
+RENDERER_TARGET_AVX2
+static void shadowBatchAVX2(const In& in, size_t b, size_t e, const VertexXform& xf, ShadowVOut* out) {
+    __m256 mvp[16]; splatMat4AVX2(xf.MVP, mvp);
+    const __m256 one = _mm256_set1_ps(1.0f), sw = _mm256_set1_ps(float(xf.W - 1)), sh = _mm256_set1_ps(float(xf.H - 1));
+    alignas(32) float C[4][8], Z[8], IW[8]; alignas(32) int SX[8], SY[8];
+    size_t i = b;
+    for (; i + 8 <= e; i += 8) {
+        __m256 x, y, z; loadPosAVX2(in, i, x, y, z);
+        __m256 c[4];
+        for (int r = 0; r < 4; ++r) { c[r] = xformRowAVX2(mvp, r, x, y, z); _mm256_store_ps(C[r], c[r]); }
+        __m256 iw = _mm256_div_ps(one, c[3]);
+        _mm256_store_ps(IW, iw);
+        _mm256_store_ps(Z, _mm256_mul_ps(c[2], iw));
+        _mm256_store_si256((__m256i*)SX, screenFxAVX2(_mm256_mul_ps(c[0], iw), sw, false));
+        _mm256_store_si256((__m256i*)SY, screenFxAVX2(_mm256_mul_ps(c[1], iw), sh, true));
+        for (int l = 0; l < 8; ++l) {
+            ShadowVOut& o = out[i + l];
+            o.clip = glm::vec4(C[0][l], C[1][l], C[2][l], C[3][l]);
+            o.screen = glm::ivec2(SX[l], SY[l]);
+            o.depth01 = Z[l]; o.invW = IW[l];
+        }
+    }
+    shadowBatchScalar(in, i, e, xf, out);
+}
+#endif
+
+template<typename In>
+static inline VertexBatchFn<In> vertexBatchFnFor(SimdLevel l) {
+#if RENDERER_X86
+    if (l == SimdLevel::AVX2) return vertexBatchAVX2<In>;
+    if (l == SimdLevel::SSE41) return vertexBatchSSE41<In>;
+#else
+    (void)l;
+#endif
+    return vertexBatchScalar<In>;
+}
+
+template<typename In>
+static inline ShadowBatchFn<In> shadowBatchFnFor(SimdLevel l) {
+#if RENDERER_X86
+    if (l == SimdLevel::AVX2) return shadowBatchAVX2<In>;
+    if (l == SimdLevel::SSE41) return shadowBatchSSE41<In>;
+#else
+    (void)l;
+#endif
+    return shadowBatchScalar<In>;
+}
+
+// 顶点阶段的输入：浮点或压缩格式之一（网格二选一存放），按格式分派到对应的内核
+struct VertexSource {
+    const VertexStreams* streams = nullptr;
+    const QuantizedStreams* quantized = nullptr;
+    VertexSource() {}
+    VertexSource(const VertexStreams& s) : streams(&s) {}
+    VertexSource(const QuantizedStreams& q) : quantized(&q) {}
+    size_t size() const { return quantized ? quantized->size() : (streams ? streams->size() : 0); }
+    bool operator==(const VertexSource& o) const { return streams == o.streams && quantized == o.quantized; }
+};
+
+// 相机通道顶点阶段：out 须有 in.size() 项；[b, e) 可按块并行。light 为同一网格的阴影通道顶点（可为空）
+static inline void vertexStageBatch(const VertexSource& in, size_t b, size_t e, const VertexXform& xf, const ShadowVOut* light, VertexOut* out) {
+    if (in.quantized) vertexBatchFnFor<QuantizedStreams>(rasterSimdLevel())(*in.quantized, b, e, xf, light, out);
+    else vertexBatchFnFor<VertexStreams>(rasterSimdLevel())(*in.streams, b, e, xf, light, out);
+}
+
+// 阴影通道顶点阶段（xf 由 makeLightXform 建立）
+static inline void vertexStageLightBatch(const VertexSource& in, size_t b, size_t e, const VertexXform& xf, ShadowVOut* out) {
+    if (in.quantized) shadowBatchFnFor<QuantizedStreams>(rasterSimdLevel())(*in.quantized, b, e, xf, out);
+    else shadowBatchFnFor<VertexStreams>(rasterSimdLevel())(*in.streams, b, e, xf, out);
+}
+
+// 按顶点块（kVertexBlock 个一块）标记只变换部分顶点：need 为空表示全部。
+// 对 [b, e) 块内连续的被标记块调用 f(vb, ve)（顶点范围，末块截到 count）
+static const size_t kVertexBlock = 8;
+
+template<typename F>
+static inline void forEachMarkedRun(const std::uint8_t* need, size_t b, size_t e, size_t count, F f) {
+    while (b < e) {
+        if (need && !need[b]) { ++b; continue; }
+        size_t r = b + 1;
+        while (r < e && (!need || need[r])) ++r;
+        f(b * kVertexBlock, std::min(r * kVertexBlock, count));
+        b = r;
+    }
+}
+
+static inline size_t vertexBlockCount(size_t count) { return (count + kVertexBlock - 1) / kVertexBlock; }
+
+// 实例化：全局块号 g = 实例槽 s * nb + 实例内块号（nb = vertexBlockCount(count)），need 按同样布局标记。
+// 对 [b, e) 中各实例被标记的连续块调用 f(s, vb, ve)（实例内顶点范围），跨实例的块区间可整体并行切分
+template<typename F>
+static inline void forEachInstanceRun(const std::uint8_t* need, size_t nb, size_t count, size_t b, size_t e, F f) {
+    while (b < e) {
+        size_t s = b / nb, lb = b - s * nb, le = std::min(nb, lb + (e - b));
+        forEachMarkedRun(need ? need + s * nb : nullptr, lb, le, count, [&](size_t vb, size_t ve) { f(s, vb, ve); });
+        b += le - lb;
+    }
+}
+
+// 一个网格的光空间顶点（阴影通道的输入，也是相机通道 lightClip 的来源），以 (M, LVP, 尺寸, 输入) 为键跨帧复用：
+// 模型矩阵与光源都没变时跳过阴影通道的顶点变换。按顶点块记录是否已变换，只有用到的块才变换
+struct LightVertexCache {
+    std::vector<ShadowVOut> verts;
+    std::vector<std::uint8_t> done; // 每个顶点块是否已按当前键变换
+    VertexXform xf{};
+    glm::mat4 M{ 1.0f }, LVP{ 1.0f };
+    VertexSource src;
+    size_t count = 0;
+    bool valid = false;
+
+    // 登记本帧的键；返回 true 表示键已改变，之前的变换结果全部作废
+    bool update(const VertexSource& in, const glm::mat4& model, const glm::mat4& lightVP, int W, int H) {
+        if (valid && src == in && count == in.size() && xf.W == W && xf.H == H && M == model && LVP == lightVP) return false;
+        src = in; count = in.size(); M = model; LVP = lightVP;
+        xf = makeLightXform(model, lightVP, W, H);
+        verts.resize(count);
+        done.assign(vertexBlockCount(count), 0);
+        valid = true;
+        return true;
+    }
+    // 变换 [b, e) 块中被 need 标记（为空表示全部）且尚未变换的块；不同块范围可并行
+    void transformBlocks(const std::uint8_t* need, size_t b, size_t e) {
+        while (b < e) {
+            if (done[b] || (need && !need[b])) { ++b; continue; }
+            size_t r = b;
+            while (r < e && !done[r] && (!need || need[r])) done[r++] = 1;
+            vertexStageLightBatch(src, b * kVertexBlock, std::min(r * kVertexBlock, count), xf, verts.data());
+            b = r;
+        }
+    }
+    size_t blockCount() const { return done.size(); }
+    void invalidate() { valid = false; } // 输入顶点内容改变时调用
+};
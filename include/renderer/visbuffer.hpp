@@ -0,0 +1,110 @@
+#pragma once
+// 可见性缓冲（延迟着色）：光栅阶段只写深度与三角形编号，解析阶段对每个可见像素着色一次
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "pipeline.hpp"
+#include "raster.hpp"
+#include "binning.hpp"
+#include "buffers.hpp"
+#include "common.hpp"
+
+static const std::uint32_t kVisEmpty = 0xffffffffu; // 背景
+
+// 每像素记录最近三角形的帧内编号（见 kBinTriBits）
+struct VisBuffer {
+    int w, h;
+    std::vector<std::uint32_t> id;
+    VisBuffer(int W, int H) : w(W), h(H), id((size_t)W * H, kVisEmpty) {}
+    void clear(const RectI& r) {
+        for (int y = r.y0; y <= r.y1; ++y) std::fill(&id[(size_t)y * w + r.x0], &id[(size_t)y * w + r.x1] + 1, kVisEmpty);
+    }
+};
+
+// 与 RasterTexKernel 相同的覆盖/深度测试，通过的像素只记录 triId
+static inline void rasterTriangleVis(const VertexOut& V0, const VertexOut& V1, const VertexOut& V2, std::uint32_t triId,
+    VisBuffer& vb, DepthBuffer& db, bool enableCull, const RectI& clip) {
+    if (!acceptTriangleTex(V0, V1, V2, enableCull)) return;
+
+    const VertexOut* v0 = &V0; const VertexOut* v1 = &V1; const VertexOut* v2 = &V2;
+    glm::ivec2 p0 = v0->screen, p1 = v1->screen, p2 = v2->screen;
+    std::int64_t area = edgeFunctionFx(p0, p1, p2); if (area == 0) return; if (area < 0) { std::swap(v1, v2); std::swap(p1, p2); area = -area; }
+
+    int minX = std::max(clip.x0, fxFirstPixel(std::min(p0.x, std::min(p1.x, p2.x))));
+    int maxX = std::min(clip.x1, fxLastPixel(std::max(p0.x, std::max(p1.x, p2.x))));
+    int minY = std::max(clip.y0, fxFirstPixel(std::min(p0.y, std::min(p1.y, p2.y))));
+    int maxY = std::min(clip.y1, fxLastPixel(std::max(p0.y, std::max(p1.y, p2.y))));
+    if (minX > maxX || minY > maxY) return;
+
+    EdgeFx e[3] = { setupEdgeFx(p1, p2, minX, minY), setupEdgeFx(p2, p0, minX, minY), setupEdgeFx(p0, p1, minX, minY) };
+    if ((maxX - minX + 1) * (maxY - minY + 1) <= kSmallTriPixels) {
+        std::uint32_t mask = coverageMaskSmall(e, minX, minY, maxX, maxY);
+        if (!mask) return;
+        PlaneSetup ps = setupPlanes(e, minX, minY, area, p0, p1, p2, db.w, db.h);
+        AttrPlane zPlane; float zLo, zHi; setupDepthPlane(zPlane, zLo, zHi, ps, *v0, *v1, *v2);
+        rasterSmallTriangle(db, mask, zPlane, ps, zLo, zHi, minX, minY, maxX, [&](int x, int y, float) { vb.id[(size_t)y * vb.w + x] = triId; });
+        return;
+    }
+    PlaneSetup ps = setupPlanes(e, minX, minY, area, p0, p1, p2, db.w, db.h);
+    RasterRowIn in; AttrPlane zPlane;
+    RasterRowFn rowFn = setupRasterRow(in, zPlane, e, ps, *v0, *v1, *v2, maxX - minX, maxY - minY);
+    RasterRowOut passed;
+
+    rasterBlocksHiZ(db, e, minX, minY, maxX, maxY, in.zLo, in.zHi, [&](int y, int xs, int xe) {
+        beginRasterRow(in, zPlane, e, minX, minY, ps, xs, y);
+        int n = rowFn(in, xs, xe, &db.z[(size_t)y * db.w], &passed);
+        std::uint32_t* row = &vb.id[(size_t)y * vb.w];
+        for (int i = 0; i < n; ++i) row[passed.x[i]] = triId;
+        return n;
+        });
+}
+
+// 解析时重建三角形的插值平面：顶点顺序与平面原点都和光栅时一致，着色结果与前向着色逐位相同
+template<ShadingMode Mode, bool Shadows, bool Lighting>
+static inline void setupVisTriangle(ShadePlanes& sp, PlaneSetup& ps, const VertexOut& V0, const VertexOut& V1, const VertexOut& V2, int W, int H) {
+    const VertexOut* v1 = &V1; const VertexOut* v2 = &V2;
+    glm::ivec2 p0 = V0.screen, p1 = V1.screen, p2 = V2.screen;
+    std::int64_t area = edgeFunctionFx(p0, p1, p2);
+    if (area < 0) { std::swap(v1, v2); std::swap(p1, p2); area = -area; }
+    EdgeFx e[3] = { setupEdgeFx(p1, p2, 0, 0), setupEdgeFx(p2, p0, 0, 0), setupEdgeFx(p0, p1, 0, 0) };
+    ps = setupPlanes(e, 0, 0, area, p0, p1, p2, W, H);
+    setupShadePlanes<Mode, Shadows, Lighting>(sp, ps, V0, *v1, *v2);
+}
+
+// 解析矩形 r 内的像素（各 tile 互不重叠，可并行）；深度取自 db，drawTex[draw] 为各绘制的纹理。
+// 一帧分多轮光栅化时（见 Renderer 的实例分批），只有第一轮 firstRound 把背景写成 clearColor，
+// 之后各轮没有新三角形的像素保持前几轮的结果
+typedef void (*ResolveVisFn)(const VisBuffer& vb, const DepthBuffer& db, const TileBins<VertexOut>& tb, const RectI& r,
+    const Texture2D* const* drawTex, Framebuffer& fb, std::uint32_t clearColor, bool firstRound, const DepthBuffer& shadowMap,
+    const glm::vec3& Ldir, const glm::vec3& ambient, const glm::vec3& lightColor);
+
+template<ShadingMode Mode, bool Bilinear, bool Shadows, bool Lighting>
+struct ResolveVisKernel {
+    typedef ResolveVisFn Fn;
+    static void run(const VisBuffer& vb, const DepthBuffer& db, const TileBins<VertexOut>& tb, const RectI& r,
+        const Texture2D* const* drawTex, Framebuffer& fb, std::uint32_t clearColor, bool firstRound, const DepthBuffer& shadowMap,
+        const glm::vec3& Ldir, const glm::vec3& ambient, const glm::vec3& lightColor) {
+        std::uint32_t cur = kVisEmpty; ShadePlanes sp; PlaneSetup ps; const Texture2D* tex = nullptr;
+        for (int y = r.y0; y <= r.y1; ++y) {
+            const std::uint32_t* ids = &vb.id[(size_t)y * vb.w];
+            const float* zrow = &db.z[(size_t)y * db.w];
+            std::uint32_t* out = &fb.pixels[(size_t)y * fb.w];
+            for (int x = r.x0; x <= r.x1; ++x) {
+                std::uint32_t id = ids[x];
+                if (id == kVisEmpty) { if (firstRound) out[x] = clearColor; continue; }
+                if (id != cur) { // 相邻像素大多属于同一三角形，沿用上次的设置
+                    const BinChunk<VertexOut>& c = tb.chunkOf(id);
+                    const glm::ivec3& tri = tb.triangle(id);
+                    setupVisTriangle<Mode, Shadows, Lighting>(sp, ps, c.vert(tri.x), c.vert(tri.y), c.vert(tri.z), vb.w, vb.h);
+                    tex = drawTex[c.draw]; cur = id;
+                }
+                out[x] = shadeFragmentT<Mode, Bilinear, Shadows, Lighting>(sp, float(x - ps.ox), float(y - ps.oy), zrow[x], *tex, shadowMap, Ldir, ambient, lightColor);
+            }
+        }
+    }
+};
+
+static inline ResolveVisFn resolveVisFnFor(ShadingMode mode, bool bilinear, bool enableShadows, bool enableLighting) {
+    return selectShadeKernel<ResolveVisKernel>(mode, bilinear, enableShadows, enableLighting);
+}
@@ -1,6 +1,9 @@
 #include <SDL.h>
 #include <cstdio>
+#include <cstdlib>
 #include <cmath>
+#include <atomic>
+#include <new>
 #include <vector>
 #include <string>
 
@@ -9,14 +12,25 @@
 #include "renderer/camera.hpp"
 #include "renderer/texture.hpp"
 #include "renderer/obj_loader.hpp"
-#include "renderer/pipeline.hpp"
-#include "renderer/raster.hpp"
-#include "renderer/light.hpp"
 #include "renderer/input_win.hpp"
+#include "renderer/scene.hpp"
+#include "renderer/renderer.hpp"
+#include "renderer/mesh_cache.hpp"
+
+// 堆分配计数（替换全局 operator new）：用来确认稳态下每帧零分配
+static std::atomic<std::uint64_t> g_heapAllocs{ 0 };
+void* operator new(std::size_t n) {
+    g_heapAllocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
 
 int main(int argc, char** argv) {
     const int width = 1280, height = 720;
     const int SHADOW_W = 1024, SHADOW_H = 1024;
+    const int MODEL_LOD_LEVELS = 8; // 模型网格的 LOD 级数上限（每级约减半三角形）
 
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0) { std::printf("SDL_Init Error: %s\n", SDL_GetError()); return 1; }
     SDL_Window* window = SDL_CreateWindow("Software Renderer: OBJ + Texture + Lambert + ShadowMap + Ground", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, SDL_WINDOW_SHOWN);
@@ -28,36 +42,57 @@ int main(int argc, char** argv) {
 
     SDL_SetRelativeMouseMode(SDL_TRUE);
 
-    Framebuffer fb(width, height);
-    DepthBuffer  zbuf(width, height);
-    DepthBuffer  shadowMap(SHADOW_W, SHADOW_H);
+    // 渲染器持有帧缓冲、阴影贴图、线程池、分块表与帧内存；每帧提交绘制命令
+    Renderer rdr(width, height, SHADOW_W, SHADOW_H);
     Camera cam;
+    std::printf("Render threads: %d, raster kernel: %s\n", rdr.pool().size(), simdLevelName(rasterSimdLevel()));
 
-    // У [model.obj] [texture.xxx]
-    const char* objPath = nullptr; const char* texPath = nullptr;
+    // 命令行： [model.obj] [texture.xxx] [--grid N] [--instances N] [--quantize] [--no-cache]
+    const char* objPath = nullptr; const char* texPath = nullptr; int gridN = 0, instN = 0; bool quantize = false, useCache = true;
     for (int i = 1; i < argc; ++i) {
         std::string s = argv[i];
-        if (s.size() >= 4 && (s.substr(s.size() - 4) == ".obj" || s.substr(s.size() - 4) == ".OBJ")) objPath = argv[i];
+        if (s == "--grid" && i + 1 < argc) gridN = std::max(0, std::atoi(argv[++i]));
+        else if (s == "--instances" && i + 1 < argc) instN = std::max(0, std::atoi(argv[++i]));
+        else if (s == "--quantize") quantize = true;
+        else if (s == "--no-cache") useCache = false;
+        else if (s.size() >= 4 && (s.substr(s.size() - 4) == ".obj" || s.substr(s.size() - 4) == ".OBJ")) objPath = argv[i];
         else texPath = argv[i];
     }
 
-    // ģṩأ
+    // 模型纹理：提供则加载，否则棋盘
     Texture2D texModel;
     if (texPath && texModel.load(texPath)) { std::printf("Loaded texture: %s (%dx%d)\n", texPath, texModel.w, texModel.h); }
     else { texModel.makeChecker(512, 512, 16); if (texPath) std::printf("Failed to load texture %s, fallback to checkerboard.\n", texPath); else std::printf("Using generated checkerboard texture.\n"); }
 
-    // 棨ɫ
+    // 地面（白色）
     Texture2D texWhite; texWhite.makeSolid(255, 255, 255, 255);
 
-    //  OBJʾ
+    // 场景：网格加载时切分 meshlet（会重排三角形与顶点）并转成 SoA；对象带各自的光空间顶点缓存。
+    // --grid N 额外摆放 N x N 个静止的模型副本；--quantize 以压缩格式存放网格（顶点阶段解码）
+    Scene scene;
+    int modelMesh = -1;
+
+    // 网格：优先 OBJ（渲染线程池并行解析，合并逐位相同的顶点），否则立方体示例。
+    // OBJ 建好的网格（含 LOD 链与 meshlet）写入旁路缓存 <model.obj>.meshcache，之后启动直接映射使用（--no-cache 关闭）
     std::vector<VertexIn> meshVerts; std::vector<glm::ivec3> meshIdx;
     if (objPath) {
-        if (loadOBJ(objPath, meshVerts, meshIdx, true, true)) {
-            std::printf("Loaded OBJ: %s  verts=%zu  tris=%zu", objPath, meshVerts.size(), meshIdx.size()); }
+        OBJLoadOptions objOpt; objOpt.mergeVertices = true; objOpt.pool = &rdr.pool();
+        Uint64 loadStart = SDL_GetPerformanceCounter();
+        MeshCacheKey cacheKey; const std::string cachePath = meshCachePath(objPath);
+        bool haveKey = useCache && makeMeshCacheKey(objPath, objOpt, MODEL_LOD_LEVELS, quantize, cacheKey);
+        if (haveKey) modelMesh = loadMeshCache(cachePath, cacheKey, scene);
+        if (modelMesh >= 0) {
+            std::printf("Loaded mesh cache: %s  %.1f ms\n", cachePath.c_str(), (SDL_GetPerformanceCounter() - loadStart) * 1000.0 / (double)SDL_GetPerformanceFrequency()); }
+        else if (loadOBJ(objPath, meshVerts, meshIdx, objOpt)) {
+            std::printf("Loaded OBJ: %s  verts=%zu  tris=%zu\n", objPath, meshVerts.size(), meshIdx.size());
+            modelMesh = scene.addMesh(std::move(meshVerts), std::move(meshIdx), MODEL_LOD_LEVELS, quantize);
+            std::printf("Mesh built in %.1f ms\n", (SDL_GetPerformanceCounter() - loadStart) * 1000.0 / (double)SDL_GetPerformanceFrequency());
+            if (haveKey && !saveMeshCache(cachePath, cacheKey, scene, modelMesh)) std::printf("Failed to write mesh cache %s\n", cachePath.c_str());
+        }
         else { std::printf("Failed to load OBJ %s, fallback to cube.\n", objPath); }
         }
-        if (meshVerts.empty() || meshIdx.empty()) {
-            // 24 壨ÿ UV/ߣ
+        if (modelMesh < 0) {
+            // 24 顶点立方体（每面独立 UV/法线）
             std::vector<VertexIn> cube(24);
             auto V = [&](int i, glm::vec3 p, glm::vec2 uv, glm::vec3 n, glm::vec3 color = glm::vec3(1)) { cube[i].pos = p; cube[i].uv = uv; cube[i].color = color; cube[i].normal = n; };
             V(0, { -0.5f,-0.5f, 0.5f }, { 0,1 }, { 0,0, 1 }); V(1, { 0.5f,-0.5f, 0.5f }, { 1,1 }, { 0,0, 1 }); V(2, { 0.5f, 0.5f, 0.5f }, { 1,0 }, { 0,0, 1 }); V(3, { -0.5f, 0.5f, 0.5f }, { 0,0 }, { 0,0, 1 });
@@ -69,10 +104,10 @@ int main(int argc, char** argv) {
             std::vector<glm::ivec3> idx = {
                 {0,1,2},{0,2,3}, {4,5,6},{4,6,7}, {8,9,10},{8,10,11}, {12,13,14},{12,14,15}, {16,17,18},{16,18,19}, {20,21,22},{20,22,23}
             };
-            meshVerts = std::move(cube); meshIdx = std::move(idx);
+            modelMesh = scene.addMesh(std::move(cube), std::move(idx), MODEL_LOD_LEVELS, quantize);
         }
 
-        // ɫ飨λ y = -2
+        // 地面白色方块（位于 y = -2）
         std::vector<VertexIn> groundVerts(4);
         auto GV = [&](int i, glm::vec3 p, glm::vec2 uv, glm::vec3 n) { groundVerts[i].pos = p; groundVerts[i].uv = uv; groundVerts[i].color = glm::vec3(1.0f); groundVerts[i].normal = n; };
         float gHalf = 2.0f, gy = -2.0f;
@@ -82,20 +117,44 @@ int main(int argc, char** argv) {
         GV(3, { -gHalf, gy,  gHalf }, { 0,0 }, { 0,1,0 });
         std::vector<glm::ivec3> groundIdx = { {0,2,1}, {0,3,2} };
 
-        bool running = true; double freq = (double)SDL_GetPerformanceFrequency(); Uint64 t0 = SDL_GetPerformanceCounter();
-        const float mouseSensitivity = 0.12f; bool mouseCaptured = true; bool enableCull = true; bool bilinear = true;
+        const Texture2D* textures[2] = { &texModel, &texWhite };
+        int modelObj = scene.addObject(modelMesh, 0, glm::mat4(1.0f));
+        scene.addObject(scene.addMesh(std::move(groundVerts), std::move(groundIdx), 0, quantize), 1, glm::mat4(1.0f));
+        for (int gz = 0; gz < gridN; ++gz)
+            for (int gx = 0; gx < gridN; ++gx)
+                scene.addObject(modelMesh, 0, glm::translate(glm::mat4(1.0f), glm::vec3((gx - 0.5f * (gridN - 1)) * 2.5f, 0.0f, -3.0f - gz * 2.5f)));
+        std::printf("Objects: %zu, meshlets per model: %zu, LOD tris:", scene.objects.size(), scene.meshes[modelMesh].meshlets.meshlets.size());
+        size_t meshBytes = 0;
+        for (int id : scene.meshes[modelMesh].lods) {
+            const SceneMesh& m = scene.meshes[id];
+            std::printf(" %zu", m.triCount()); meshBytes += m.vertexBytes() + m.indexBytes();
+        }
+        std::printf(", vertex+index data: %zu KB (%s)\n", meshBytes / 1024, quantize ? "quantized" : "float");
+        // --instances N：模型前方 N x N 个缩小、各自朝向不同的副本，作为一次实例化绘制提交（共享模型网格）
+        std::vector<glm::mat4> instanceModels;
+        instanceModels.reserve((size_t)instN * instN);
+        for (int iz = 0; iz < instN; ++iz)
+            for (int ix = 0; ix < instN; ++ix) {
+                glm::mat4 M = glm::translate(glm::mat4(1.0f), glm::vec3((ix - 0.5f * (instN - 1)) * 1.25f, -1.5f, 3.0f + iz * 1.25f));
+                M = glm::rotate(M, (float)(iz * instN + ix) * 0.37f, glm::vec3(0, 1, 0));
+                instanceModels.push_back(glm::scale(M, glm::vec3(0.4f)));
+            }
+        std::vector<std::vector<glm::mat4>> instanceLods(scene.meshes[modelMesh].lods.size()); // 每帧按 LOD 分组的实例
+        bool lodEnabled = true;
 
-        // Ӱ
-        bool enableLighting = true; bool enableShadows = true;
-        ShadingMode mode = ShadingMode::Shaded; // ʼΪɫ
+        bool running = true; double freq = (double)SDL_GetPerformanceFrequency(); Uint64 t0 = SDL_GetPerformanceCounter();
+        const float mouseSensitivity = 0.12f; bool mouseCaptured = true; bool enableCull = true;
         glm::vec3 lightDirWS = glm::normalize(glm::vec3(0.5f, 1.0f, 0.3f));
-        glm::vec3 ambient(0.15f), lightColor(1.0f);
 
 #ifdef _WIN32
         KeyInput keys;
+        std::uint64_t lastFrameAllocs = 0; // 'F' 键打印
 #endif
 
         while (running) {
+#ifdef _WIN32
+            std::uint64_t allocsAtFrameStart = g_heapAllocs.load(std::memory_order_relaxed);
+#endif
             Uint64 t1 = SDL_GetPerformanceCounter(); float dt = float((t1 - t0) / freq); t0 = t1;
             SDL_Event e; int mouseDX = 0, mouseDY = 0;
             while (SDL_PollEvent(&e)) {
@@ -105,14 +164,28 @@ int main(int argc, char** argv) {
 
 #ifdef _WIN32
             keys.update();
+            RenderSettings& rs = rdr.settings;
             if (keys.pressed(VK_ESCAPE)) running = false;
             if (keys.pressed(VK_TAB)) { mouseCaptured = !mouseCaptured; SDL_SetRelativeMouseMode(mouseCaptured ? SDL_TRUE : SDL_FALSE); }
             if (keys.pressed('C')) enableCull = !enableCull;
-            if (keys.pressed('B')) bilinear = !bilinear;
-            if (keys.pressed('L')) { enableLighting = !enableLighting; std::printf("Lighting: %s\n", enableLighting ? "ON" : "OFF"); }
+            if (keys.pressed('B')) rs.bilinear = !rs.bilinear;
+            if (keys.pressed('X')) { // 光栅内核降级循环：检测到的最高级 -> ... -> Scalar -> 最高级
+                SimdLevel& lv = rasterSimdLevel();
+                lv = (lv == SimdLevel::Scalar) ? detectSimdLevel() : (lv == SimdLevel::AVX2 ? SimdLevel::SSE41 : SimdLevel::Scalar);
+                std::printf("Raster kernel: %s\n", simdLevelName(lv));
+            }
+            if (keys.pressed('T')) { ThreadPool& pool = rdr.pool(); pool.setSerial(!pool.serial()); std::printf("Threads: %s\n", pool.serial() ? "1 (serial)" : "ALL"); }
+            if (keys.pressed('V')) { rs.visibilityBuffer = !rs.visibilityBuffer; std::printf("Shading: %s\n", rs.visibilityBuffer ? "visibility buffer" : "forward"); }
+            if (keys.pressed('F')) std::printf("Heap allocations last frame: %llu, frame arena: %zu / %zu KB, draws: %zu, instances: %zu\n",
+                (unsigned long long)lastFrameAllocs, rdr.arena().used() / 1024, rdr.arena().capacity() / 1024, rdr.lastDrawCount(), rdr.lastInstanceCount());
+            if (keys.pressed('O')) { lodEnabled = !lodEnabled; std::printf("LOD: %s\n", lodEnabled ? "ON" : "OFF"); }
+            if (keys.pressed('G')) { rs.meshletCulling = !rs.meshletCulling; std::printf("Meshlet culling: %s\n", rs.meshletCulling ? "ON" : "OFF"); }
+            if (keys.pressed('K')) { rs.msaaSamples = (rs.msaaSamples == 0) ? 4 : (rs.msaaSamples == 4 ? 8 : 0); std::printf("MSAA: %dx\n", rs.msaaSamples); }
+            if (keys.pressed('L')) { rs.lighting = !rs.lighting; std::printf("Lighting: %s\n", rs.lighting ? "ON" : "OFF"); }
             if (keys.pressed('H')) {
-                enableShadows = !enableShadows; std::printf("Shadows: %s", enableShadows ? "ON" : "OFF"); }
-                    if (keys.pressed('M')) { // ɫģʽѭShaded -> UV -> Depth -> Shaded
+                rs.shadows = !rs.shadows; std::printf("Shadows: %s", rs.shadows ? "ON" : "OFF"); }
+                    if (keys.pressed('M')) { // 着色模式循环：Shaded -> UV -> Depth -> Shaded
+                        ShadingMode& mode = rs.mode;
                         if (mode == ShadingMode::Shaded) mode = ShadingMode::UV;
                         else if (mode == ShadingMode::UV) mode = ShadingMode::Depth;
                         else mode = ShadingMode::Shaded;
@@ -129,68 +202,40 @@ int main(int argc, char** argv) {
 
                 float aspect = float(width) / float(height);
 
-                // ģת
+                // 模型自转
                 glm::mat4 M_model = glm::rotate(glm::mat4(1.0f), float(SDL_GetTicks64() * 0.001) * 0.5f, glm::vec3(0, 1, 0));
-                glm::mat4 M_ground = glm::mat4(1.0f);
-
-                glm::mat4 V = cam.view(); glm::mat4 P = cam.proj(aspect);
-                glm::mat4 MVP_model = P * V * M_model; glm::mat4 MVP_ground = P * V * M_ground;
-                glm::mat3 normalMat_model = glm::transpose(glm::inverse(glm::mat3(M_model)));
-                glm::mat3 normalMat_ground = glm::transpose(glm::inverse(glm::mat3(M_ground)));
-
-                // Դÿ֡£
-                glm::mat4 Lview, Lproj, LVP; buildLightMatrices(lightDirWS, Lview, Lproj, LVP);
-
-                // ---------- Shadow Pass ----------
-                shadowMap.clear(1.0f);
-                std::vector<ShadowVOut> lightModel(meshVerts.size());
-                for (size_t i = 0; i < meshVerts.size(); ++i) lightModel[i] = vertexStageLight(meshVerts[i].pos, M_model, LVP, SHADOW_W, SHADOW_H);
-                std::vector<ShadowVOut> lightGround(groundVerts.size());
-                for (size_t i = 0; i < groundVerts.size(); ++i) lightGround[i] = vertexStageLight(groundVerts[i].pos, M_ground, LVP, SHADOW_W, SHADOW_H);
-
-                bool cullFrontInShadow = true; // ޳Լ acne
-                for (auto t : meshIdx) {
-                    const ShadowVOut& A = lightModel[t.x], & B = lightModel[t.y], & C = lightModel[t.z]; ShadowVOut poly[4];
-                    int nv = clipTriangleNearZO(A, B, C, poly, SHADOW_W, SHADOW_H);
-                    if (nv == 3) rasterTriangleDepth(poly[0], poly[1], poly[2], shadowMap, cullFrontInShadow);
-                    else if (nv == 4) { rasterTriangleDepth(poly[0], poly[1], poly[2], shadowMap, cullFrontInShadow); rasterTriangleDepth(poly[0], poly[2], poly[3], shadowMap, cullFrontInShadow); }
-                }
-                for (auto t : groundIdx) {
-                    const ShadowVOut& A = lightGround[t.x], & B = lightGround[t.y], & C = lightGround[t.z]; ShadowVOut poly[4];
-                    int nv = clipTriangleNearZO(A, B, C, poly, SHADOW_W, SHADOW_H);
-                    if (nv == 3) rasterTriangleDepth(poly[0], poly[1], poly[2], shadowMap, cullFrontInShadow);
-                    else if (nv == 4) { rasterTriangleDepth(poly[0], poly[1], poly[2], shadowMap, cullFrontInShadow); rasterTriangleDepth(poly[0], poly[2], poly[3], shadowMap, cullFrontInShadow); }
-                }
 
-                // ---------- Camera Pass ----------
-                fb.clear(packARGB8(glm::vec3(0.07f, 0.07f, 0.1f))); zbuf.clear(1.0f);
-
-                std::vector<VertexOut> voModel(meshVerts.size());
-                for (size_t i = 0; i < meshVerts.size(); ++i) voModel[i] = vertexStage(meshVerts[i], M_model, MVP_model, LVP, normalMat_model, width, height);
-                std::vector<VertexOut> voGround(groundVerts.size());
-                for (size_t i = 0; i < groundVerts.size(); ++i) voGround[i] = vertexStage(groundVerts[i], M_ground, MVP_ground, LVP, normalMat_ground, width, height);
-
-                for (auto t : meshIdx) {
-                    const VertexOut& A = voModel[t.x], & B = voModel[t.y], & C = voModel[t.z]; VertexOut poly[4];
-                    int nv = clipTriangleNearZO(A, B, C, poly, width, height);
-                    if (nv == 3) rasterTriangleTexShadow(poly[0], poly[1], poly[2], texModel, fb, zbuf, shadowMap, mode, enableCull, bilinear, enableShadows, enableLighting, lightDirWS, ambient, lightColor);
-                    else if (nv == 4) {
-                        rasterTriangleTexShadow(poly[0], poly[1], poly[2], texModel, fb, zbuf, shadowMap, mode, enableCull, bilinear, enableShadows, enableLighting, lightDirWS, ambient, lightColor);
-                        rasterTriangleTexShadow(poly[0], poly[2], poly[3], texModel, fb, zbuf, shadowMap, mode, enableCull, bilinear, enableShadows, enableLighting, lightDirWS, ambient, lightColor);
-                    }
-                }
-                for (auto t : groundIdx) {
-                    const VertexOut& A = voGround[t.x], & B = voGround[t.y], & C = voGround[t.z]; VertexOut poly[4];
-                    int nv = clipTriangleNearZO(A, B, C, poly, width, height);
-                    if (nv == 3) rasterTriangleTexShadow(poly[0], poly[1], poly[2], texWhite, fb, zbuf, shadowMap, mode, enableCull, bilinear, enableShadows, enableLighting, lightDirWS, ambient, lightColor);
-                    else if (nv == 4) {
-                        rasterTriangleTexShadow(poly[0], poly[1], poly[2], texWhite, fb, zbuf, shadowMap, mode, enableCull, bilinear, enableShadows, enableLighting, lightDirWS, ambient, lightColor);
-                        rasterTriangleTexShadow(poly[0], poly[2], poly[3], texWhite, fb, zbuf, shadowMap, mode, enableCull, bilinear, enableShadows, enableLighting, lightDirWS, ambient, lightColor);
-                    }
+                // ---------- Frame ----------
+                // 移动过的对象 refit BVH；相机与光源视锥各遍历一次，只提交至少对其一可见的对象
+                glm::mat4 P = cam.proj(aspect);
+                rdr.beginFrame(cam.view(), P, cam.pos, lightDirWS);
+                scene.setTransform(modelObj, M_model);
+                scene.update();
+                VisibleObject* visObjs = nullptr;
+                size_t visCount = scene.collectVisible(rdr.viewProj(), rdr.lightViewProj(), rdr.arena(), visObjs);
+                DrawState ds; ds.cullBackFaces = enableCull;
+                // LOD 按相机投影误差逐对象选择（阴影通道用同一级）；实例按级分组，每级一次实例化绘制
+                const float projScale = P[1][1] * height * 0.5f;
+                for (size_t i = 0; i < visCount; ++i) {
+                    SceneObject& o = scene.objects[visObjs[i].object];
+                    int level = lodEnabled ? scene.selectLod(o.mesh, o.model, cam.pos, projScale) : 0;
+                    rdr.submit(scene.meshes[scene.meshes[o.mesh].lods[level]], o.model, textures[o.texture], ds, &o.light,
+                        (visObjs[i].inCam ? kPassCamera : 0u) | (visObjs[i].inLight ? kPassShadow : 0u));
                 }
+                for (auto& group : instanceLods) group.clear();
+                for (const glm::mat4& M : instanceModels)
+                    instanceLods[lodEnabled ? scene.selectLod(modelMesh, M, cam.pos, projScale) : 0].push_back(M);
+                for (size_t l = 0; l < instanceLods.size(); ++l)
+                    if (!instanceLods[l].empty())
+                        rdr.submitInstanced(scene.meshes[scene.meshes[modelMesh].lods[l]], instanceLods[l].data(), instanceLods[l].size(), textures[0], ds);
+                rdr.endFrame();
+                const Framebuffer& fb = rdr.framebuffer();
 
                 SDL_UpdateTexture(texSDL, nullptr, fb.pixels.data(), width * sizeof(std::uint32_t));
                 SDL_RenderClear(renderer); SDL_RenderCopy(renderer, texSDL, nullptr, nullptr); SDL_RenderPresent(renderer);
+#ifdef _WIN32
+                lastFrameAllocs = g_heapAllocs.load(std::memory_order_relaxed) - allocsAtFrameStart;
+#endif
             }
 
             SDL_DestroyTexture(texSDL); SDL_DestroyRenderer(renderer); SDL_DestroyWindow(window); SDL_Quit(); return 0;
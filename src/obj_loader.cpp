@@ -1,10 +1,15 @@
 #include "renderer/obj_loader.hpp"
-#include <fstream>
-#include <sstream>
-#include <unordered_map>
-#include <tuple>
+#include "renderer/mesh_opt.hpp"
+#include "renderer/flat_hash.hpp"
+#include "renderer/mapped_file.hpp"
+#include "renderer/thread_pool.hpp"
+#include <string>
 #include <limits>
 #include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
 #include <glm/gtx/norm.hpp>
 
 static bool endsWith(const std::string& s, const std::string& suf) {
@@ -21,54 +26,270 @@ static bool endsWith(const std::string& s, const std::string& suf) {
 
 struct IdxKey { int v, t, n; bool operator==(const IdxKey& o) const { return v == o.v && t == o.t && n == o.n; } };
 struct IdxKeyHash {
-    size_t operator()(const IdxKey& k) const noexcept {
-        size_t h = (size_t)k.v * 73856093u ^ (size_t)(k.t + 1) * 19349663u ^ (size_t)(k.n + 2) * 83492791u;
-        return h;
+    std::uint64_t operator()(const IdxKey& k) const {
+        return mixHash64(mixHash64((std::uint32_t)k.v | ((std::uint64_t)(std::uint32_t)(k.t + 1) << 32)) ^ (std::uint32_t)(k.n + 1));
+    }
+};
+
+// 位置合并用的网格单元（边长 = 合并距离）
+struct CellKey { int x, y, z; bool operator==(const CellKey& o) const { return x == o.x && y == o.y && z == o.z; } };
+struct CellKeyHash {
+    std::uint64_t operator()(const CellKey& k) const {
+        return mixHash64(mixHash64((std::uint32_t)k.x | ((std::uint64_t)(std::uint32_t)k.y << 32)) ^ (std::uint32_t)k.z);
+    }
+};
+
+// 按距离合并位置：新位置与已有代表位置距离不超过 eps 时映射到编号最小的那个，否则自成代表。
+// 代表位置按单元串成链表，查找只看相邻的 27 个单元
+struct PositionWelder {
+    float eps;
+    FlatIndexMap<CellKey, CellKeyHash> heads; // 单元 -> 链表头（代表位置编号）
+    std::vector<int> next, canon;
+
+    explicit PositionWelder(float e) : eps(e) {}
+    CellKey cellOf(const glm::vec3& p) const { return { (int)std::floor(p.x / eps), (int)std::floor(p.y / eps), (int)std::floor(p.z / eps) }; }
+    void add(const std::vector<glm::vec3>& pos) {
+        int id = (int)canon.size(); const glm::vec3& p = pos[id];
+        CellKey c = cellOf(p); int found = -1;
+        for (int dz = -1; dz <= 1; ++dz) for (int dy = -1; dy <= 1; ++dy) for (int dx = -1; dx <= 1; ++dx)
+            for (int j = heads.find({ c.x + dx, c.y + dy, c.z + dz }); j >= 0; j = next[j])
+                if (glm::dot(pos[j] - p, pos[j] - p) <= eps * eps && (found < 0 || j < found)) found = j;
+        canon.push_back(found >= 0 ? found : id); next.push_back(-1);
+        if (found >= 0) return;
+        int head = heads.findOrInsert(c, id);
+        if (head != id) { next[id] = next[head]; next[head] = id; } // 插在链表头之后，表里的头保持不变
     }
 };
 
 static int toIndex(int idx, int count) { if (idx > 0) return idx - 1; if (idx < 0) return count + idx; return -1; }
 
-static IdxKey parseVTN(const std::string& tok, int nv, int nt, int nn) {
-    int v = -1, t = -1, n = -1; std::string num; std::vector<int> parts;
-    for (size_t i = 0; i <= tok.size(); ++i) {
-        if (i == tok.size() || tok[i] == '/') { if (!num.empty()) { parts.push_back(std::stoi(num)); num.clear(); } else parts.push_back(0); }
-        else num.push_back(tok[i]);
+// ---------- 数值解析（直接在映射的缓冲区上扫描，不分配） ----------
+static const float kPow10f[11] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+static const double kPow10d[23] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+static inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; }
+static inline bool isDigit(char c) { return (unsigned)(c - '0') < 10u; }
+
+// 十进制浮点数，结果与 strtof 逐位相同（就近偶数舍入）：尾数与 10 的幂都能精确表示时一次乘除即为正确舍入
+// （float：尾数 <= 2^24、|指数| <= 10；double：尾数 <= 2^53、|指数| <= 22，且结果不落在两个 float 的正中间），
+// 其余情况（很长的尾数、很大的指数、非规格化数）交给 strtof。无数字时返回 false，p 不动
+static bool parseFloat(const char*& p, const char* e, float& out) {
+    const char* s = p; const char* q = p;
+    bool neg = false;
+    if (q < e && (*q == '+' || *q == '-')) neg = *q++ == '-';
+    std::uint64_t m = 0; int exp10 = 0, digits = 0; bool any = false, truncated = false;
+    for (; q < e && isDigit(*q); ++q) {
+        any = true;
+        if (digits < 19) { m = m * 10 + (unsigned)(*q - '0'); if (m) ++digits; }
+        else { ++exp10; truncated |= *q != '0'; }
+    }
+    if (q < e && *q == '.') {
+        for (++q; q < e && isDigit(*q); ++q) {
+            any = true;
+            if (digits < 19) { m = m * 10 + (unsigned)(*q - '0'); if (m) ++digits; --exp10; }
+            else truncated |= *q != '0';
+        }
+    }
+    if (!any) return false;
+    if (q < e && (*q == 'e' || *q == 'E')) {
+        const char* t = q + 1; bool eneg = false;
+        if (t < e && (*t == '+' || *t == '-')) eneg = *t++ == '-';
+        if (t < e && isDigit(*t)) {
+            int x = 0;
+            for (; t < e && isDigit(*t); ++t) if (x < 100000) x = x * 10 + (*t - '0');
+            exp10 += eneg ? -x : x; q = t;
+        }
+    }
+    p = q;
+    if (m == 0 && !truncated) { out = neg ? -0.0f : 0.0f; return true; }
+    if (!truncated) {
+        if (m <= (1u << 24) && exp10 >= -10 && exp10 <= 10) {
+            float f = (float)m; f = exp10 < 0 ? f / kPow10f[-exp10] : f * kPow10f[exp10];
+            out = neg ? -f : f; return true;
+        }
+        if (m <= (1ull << 53) && exp10 >= -22 && exp10 <= 22) {
+            double d = (double)m; d = exp10 < 0 ? d / kPow10d[-exp10] : d * kPow10d[exp10];
+            std::uint64_t bits; std::memcpy(&bits, &d, sizeof(bits));
+            if ((bits & 0x1fffffffull) != 0x10000000ull && d >= (double)std::numeric_limits<float>::min() && d <= (double)std::numeric_limits<float>::max()) {
+                out = neg ? -(float)d : (float)d; return true;
+            }
+        }
+    }
+    char buf[64]; size_t n = (size_t)(q - s);
+    if (n < sizeof(buf)) { std::memcpy(buf, s, n); buf[n] = 0; out = std::strtof(buf, nullptr); }
+    else out = std::strtof(std::string(s, q).c_str(), nullptr);
+    return true;
+}
+
+static bool parseInt(const char*& p, const char* e, int& out) {
+    const char* q = p; bool neg = false;
+    if (q < e && (*q == '+' || *q == '-')) neg = *q++ == '-';
+    if (q >= e || !isDigit(*q)) return false;
+    long long x = 0;
+    for (; q < e && isDigit(*q); ++q) if (x < (1ll << 40)) x = x * 10 + (*q - '0');
+    x = neg ? -x : x;
+    out = (int)std::max<long long>(std::min<long long>(x, std::numeric_limits<int>::max()), std::numeric_limits<int>::min());
+    p = q; return true;
+}
+
+static inline void skipBlank(const char*& p, const char* e) { while (p < e && isBlank(*p)) ++p; }
+
+static inline float readFloat(const char*& p, const char* e) {
+    float f = 0.0f; skipBlank(p, e); parseFloat(p, e, f); return f;
+}
+
+// ---------- OBJ 记录解析 ----------
+enum OBJTag { kTagOther, kTagV, kTagVT, kTagVN, kTagF };
+
+// 行首标记（跳过前导空白），p 移到标记之后；计数与解析共用，保证两者对记录的判定一致
+static inline OBJTag lineTag(const char*& p, const char* e) {
+    skipBlank(p, e);
+    const char* tag = p;
+    while (p < e && !isBlank(*p)) ++p;
+    const size_t len = (size_t)(p - tag);
+    if (len == 1) return tag[0] == 'v' ? kTagV : tag[0] == 'f' ? kTagF : kTagOther;
+    if (len == 2 && tag[0] == 'v') return tag[1] == 't' ? kTagVT : tag[1] == 'n' ? kTagVN : kTagOther;
+    return kTagOther;
+}
+
+// 逐行扫描 [begin, end)，v/vt/vn/f 记录交给 Sink：
+//   position(vec3) / texcoord(vec2) / normal(vec3) / face(const IdxKey*, int 角点数)。
+// 面的索引在此解析为绝对编号（负数相对于当前已读的数量）；v 越界的角点丢弃，vt/vn 越界视为缺失（-1）。
+// nv/nt/nn 为此前已读的 v/vt/vn 数量
+struct OBJParser {
+    bool flipV = true;
+    int nv = 0, nt = 0, nn = 0;
+    std::vector<IdxKey> corners; // 当前面的角点（跨行复用）
+
+    template<typename Sink>
+    void parse(const char* begin, const char* end, Sink& sink) {
+        const char* p = begin;
+        while (p < end) {
+            const char* le = static_cast<const char*>(std::memchr(p, '\n', (size_t)(end - p)));
+            if (!le) le = end;
+            parseLine(p, le, sink);
+            p = le + 1;
+        }
+    }
+
+    template<typename Sink>
+    void parseLine(const char* p, const char* e, Sink& sink) {
+        const OBJTag tag = lineTag(p, e);
+        if (tag == kTagV) {
+            float x = readFloat(p, e), y = readFloat(p, e), z = readFloat(p, e);
+            sink.position(glm::vec3(x, y, z)); ++nv;
+        }
+        else if (tag == kTagVT) {
+            float u = readFloat(p, e), v = readFloat(p, e);
+            if (flipV) v = 1.0f - v;
+            sink.texcoord(glm::vec2(u, v)); ++nt;
+        }
+        else if (tag == kTagVN) {
+            float x = readFloat(p, e), y = readFloat(p, e), z = readFloat(p, e);
+            sink.normal(glm::normalize(glm::vec3(x, y, z))); ++nn;
+        }
+        else if (tag == kTagF) {
+            corners.clear();
+            for (;;) {
+                skipBlank(p, e);
+                if (p >= e || *p == '#') break;
+                int v = 0, t = 0, n = 0;
+                parseInt(p, e, v);
+                if (p < e && *p == '/') { ++p; parseInt(p, e, t); if (p < e && *p == '/') { ++p; parseInt(p, e, n); } }
+                while (p < e && !isBlank(*p)) ++p; // 其余字符忽略
+                IdxKey k{ toIndex(v, nv), toIndex(t, nt), toIndex(n, nn) };
+                if (k.v < 0 || k.v >= nv) continue;
+                if (k.t < 0 || k.t >= nt) k.t = -1;
+                if (k.n < 0 || k.n >= nn) k.n = -1;
+                corners.push_back(k);
+            }
+            if (corners.size() >= 3) sink.face(corners.data(), (int)corners.size());
+        }
+    }
+};
+
+// ---------- 分块并行解析 ----------
+// 文件在行边界处切块：先并行统计各块的 v/vt/vn 数量，前缀和给出各块的起始编号；再并行解析，
+// 位置等属性直接写入全局数组的对应区间，面的角点（已解析为绝对编号）暂存在块内；
+// 最后按块顺序串行组装（去重、合并、三角化），结果与串行加载逐位相同
+static const size_t kOBJMinChunkBytes = 1 << 20;
+
+struct OBJChunk {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    int nv = 0, nt = 0, nn = 0;       // 本块的 v/vt/vn 数量
+    int baseV = 0, baseT = 0, baseN = 0; // 本块之前的数量
+    std::vector<IdxKey> corners;
+    std::vector<int> faceEnd;         // 各面角点在 corners 中的结束位置
+};
+
+static void countRecords(OBJChunk& c) {
+    const char* p = c.begin;
+    while (p < c.end) {
+        const char* le = static_cast<const char*>(std::memchr(p, '\n', (size_t)(c.end - p)));
+        if (!le) le = c.end;
+        switch (lineTag(p, le)) {
+        case kTagV: ++c.nv; break;
+        case kTagVT: ++c.nt; break;
+        case kTagVN: ++c.nn; break;
+        default: break;
+        }
+        p = le + 1;
     }
-    if (parts.size() == 1) { v = toIndex(parts[0], nv); }
-    else if (parts.size() == 2) { v = toIndex(parts[0], nv); t = toIndex(parts[1], nt); }
-    else if (parts.size() >= 3) { v = toIndex(parts[0], nv); t = toIndex(parts[1], nt); n = toIndex(parts[2], nn); }
-    return { v, t, n };
 }
 
-bool loadOBJ(const char* path, OBJMesh& out, bool normalizeToUnit, bool flipV) {
-    std::ifstream fin(path); if (!fin) return false;
-    std::vector<glm::vec3> pos; std::vector<glm::vec2> tex; std::vector<glm::vec3> nor;
-
-    std::string line;
-    while (std::getline(fin, line)) {
-        if (line.empty() || line[0] == '#') continue;
-        std::istringstream iss(line); std::string tag; iss >> tag;
-        if (tag == "v") { float x, y, z; iss >> x >> y >> z; pos.emplace_back(x, y, z); }
-        else if (tag == "vt") { float u, v; iss >> u >> v; if (flipV) v = 1.0f - v; tex.emplace_back(u, v); }
-        else if (tag == "vn") { float x, y, z; iss >> x >> y >> z; nor.emplace_back(glm::normalize(glm::vec3(x, y, z))); }
-        else if (tag == "f") {
-            std::vector<std::string> tks; std::string tk; while (iss >> tk) tks.push_back(tk); if (tks.size() < 3) continue;
-            static std::unordered_map<IdxKey, int, IdxKeyHash> table; table.clear();
-            auto getOrCreate = [&](const IdxKey& k)->int {
-                auto it = table.find(k); if (it != table.end()) return it->second;
-                VertexIn vin{}; vin.color = glm::vec3(1.0f);
-                vin.pos = (k.v >= 0 && k.v < (int)pos.size()) ? pos[k.v] : glm::vec3(0);
-                vin.uv = (k.t >= 0 && k.t < (int)tex.size()) ? tex[k.t] : glm::vec2(0);
-                vin.normal = (k.n >= 0 && k.n < (int)nor.size()) ? nor[k.n] : glm::vec3(0);
-                int idx = (int)out.verts.size(); out.verts.push_back(vin); table.emplace(k, idx); return idx;
-                };
-            std::vector<int> vidx; vidx.reserve(tks.size());
-            for (auto& s : tks) { IdxKey k = parseVTN(s, (int)pos.size(), (int)tex.size(), (int)nor.size()); if (k.v < 0 || k.v >= (int)pos.size()) continue; vidx.push_back(getOrCreate(k)); }
-            for (size_t i = 2; i < vidx.size(); ++i) out.idx.push_back(glm::ivec3(vidx[0], vidx[i - 1], vidx[i]));
+struct OBJChunkSink {
+    glm::vec3* pos; glm::vec2* tex; glm::vec3* nor;
+    OBJChunk& chunk;
+    void position(const glm::vec3& p) { *pos++ = p; }
+    void texcoord(const glm::vec2& t) { *tex++ = t; }
+    void normal(const glm::vec3& n) { *nor++ = n; }
+    void face(const IdxKey* c, int n) { chunk.corners.insert(chunk.corners.end(), c, c + n); chunk.faceEnd.push_back((int)chunk.corners.size()); }
+};
+
+// 把解析出的记录组装成网格：v/vt/vn 三元组 -> 输出顶点（整个网格共用，相同三元组的顶点在各面之间共享），
+// 可选的位置合并，多边形按扇形三角化。缺 vn 的角点默认只在本面内共享（键的 n 记为 -2 - 面号），补出的法线保持逐面
+
+struct OBJBuilder {
+    const OBJLoadOptions& opt;
+    OBJMesh& out;
+    std::vector<glm::vec3> pos, nor;
+    std::vector<glm::vec2> tex;
+    FlatIndexMap<IdxKey, IdxKeyHash> table;
+    PositionWelder welder;
+    std::vector<int> vidx;
+    int faces = 0;
+
+    OBJBuilder(const OBJLoadOptions& o, OBJMesh& m) : opt(o), out(m), welder(o.weldEpsilon) {}
+
+    void position(const glm::vec3& p) { pos.push_back(p); if (opt.weldEpsilon > 0.0f) welder.add(pos); }
+    void texcoord(const glm::vec2& t) { tex.push_back(t); }
+    void normal(const glm::vec3& n) { nor.push_back(n); }
+    void face(const IdxKey* c, int n) {
+        vidx.clear();
+        const int faceKey = -2 - faces++;
+        for (int i = 0; i < n; ++i) {
+            IdxKey k = c[i];
+            if (k.n < 0 && !opt.smoothGeneratedNormals) k.n = faceKey;
+            vidx.push_back(vertexFor(k));
         }
+        for (size_t i = 2; i < vidx.size(); ++i) out.idx.push_back(glm::ivec3(vidx[0], vidx[i - 1], vidx[i]));
     }
+    int vertexFor(IdxKey k) {
+        if (opt.weldEpsilon > 0.0f) k.v = welder.canon[k.v];
+        int idx = table.findOrInsert(k, (int)out.verts.size());
+        if (idx < (int)out.verts.size()) return idx;
+        VertexIn vin{}; vin.color = glm::vec3(1.0f);
+        vin.pos = pos[k.v];
+        vin.uv = k.t >= 0 ? tex[k.t] : glm::vec2(0);
+        vin.normal = k.n >= 0 ? nor[k.n] : glm::vec3(0);
+        out.verts.push_back(vin); return idx;
+    }
+};
 
+// 组装后的处理：补法线、单位化、合并相同顶点
+static bool finishMesh(OBJMesh& out, const OBJLoadOptions& opt) {
     if (out.verts.empty() || out.idx.empty()) return false;
 
     bool needNormals = false; for (auto& v : out.verts) { if (glm::length2(v.normal) < 1e-12f) { needNormals = true; break; } }
@@ -82,7 +303,7 @@ bool loadOBJ(const char* path, OBJMesh& out, bool normalizeToUnit, bool flipV) {
         for (size_t i = 0; i < out.verts.size(); ++i) { glm::vec3 n = acc[i]; if (glm::length2(n) < 1e-12f) n = glm::vec3(0, 0, 1); out.verts[i].normal = glm::normalize(n); }
     }
 
-    if (normalizeToUnit) {
+    if (opt.normalizeToUnit) {
         glm::vec3 mn(std::numeric_limits<float>::max()); glm::vec3 mx(-std::numeric_limits<float>::max());
         for (auto& v : out.verts) { mn = glm::min(mn, v.pos); mx = glm::max(mx, v.pos); }
         glm::vec3 center = (mn + mx) * 0.5f; glm::vec3 size = mx - mn;
@@ -90,14 +311,67 @@ bool loadOBJ(const char* path, OBJMesh& out, bool normalizeToUnit, bool flipV) {
         for (auto& v : out.verts) v.pos = (v.pos - center) * scale;
     }
 
+    if (opt.mergeVertices) mergeIdenticalVertices(out.verts, out.idx);
+
     return true;
 }
 
+static void parseChunked(const char* data, size_t size, ThreadPool& pool, OBJBuilder& builder, bool flipV) {
+    size_t chunkBytes = std::max(kOBJMinChunkBytes, size / ((size_t)pool.size() * 4) + 1);
+    std::vector<OBJChunk> chunks;
+    for (const char* p = data, *end = data + size; p < end;) {
+        const char* e = p + std::min(chunkBytes, (size_t)(end - p));
+        if (e < end) { const char* le = static_cast<const char*>(std::memchr(e, '\n', (size_t)(end - e))); e = le ? le + 1 : end; }
+        chunks.emplace_back(); chunks.back().begin = p; chunks.back().end = e;
+        p = e;
+    }
+    const int nc = (int)chunks.size();
+    pool.parallelFor(nc, [&](int c, int) { countRecords(chunks[c]); });
+    int nv = 0, nt = 0, nn = 0;
+    for (OBJChunk& c : chunks) { c.baseV = nv; c.baseT = nt; c.baseN = nn; nv += c.nv; nt += c.nt; nn += c.nn; }
+    builder.pos.resize(nv); builder.tex.resize(nt); builder.nor.resize(nn);
+    pool.parallelFor(nc, [&](int c, int) {
+        OBJChunk& ch = chunks[c];
+        OBJParser parser; parser.flipV = flipV; parser.nv = ch.baseV; parser.nt = ch.baseT; parser.nn = ch.baseN;
+        OBJChunkSink sink{ builder.pos.data() + ch.baseV, builder.tex.data() + ch.baseT, builder.nor.data() + ch.baseN, ch };
+        parser.parse(ch.begin, ch.end, sink);
+    });
+    if (builder.opt.weldEpsilon > 0.0f) for (int v = 0; v < nv; ++v) builder.welder.add(builder.pos);
+    for (OBJChunk& ch : chunks) {
+        int first = 0;
+        for (int fe : ch.faceEnd) { builder.face(ch.corners.data() + first, fe - first); first = fe; }
+        std::vector<IdxKey>().swap(ch.corners); std::vector<int>().swap(ch.faceEnd);
+    }
+}
+
+bool loadOBJ(const char* path, OBJMesh& out, const OBJLoadOptions& opt) {
+    MappedFile file(path); if (!file.data()) return false;
+    OBJBuilder builder(opt, out);
+    if (opt.pool && opt.pool->size() > 1 && file.size() >= 2 * kOBJMinChunkBytes)
+        parseChunked(file.data(), file.size(), *opt.pool, builder, opt.flipV);
+    else {
+        OBJParser parser; parser.flipV = opt.flipV;
+        parser.parse(file.data(), file.data() + file.size(), builder);
+    }
+    return finishMesh(out, opt);
+}
+
+bool loadOBJ(const char* path, OBJMesh& out, bool normalizeToUnit, bool flipV, bool mergeVertices) {
+    OBJLoadOptions opt; opt.normalizeToUnit = normalizeToUnit; opt.flipV = flipV; opt.mergeVertices = mergeVertices;
+    return loadOBJ(path, out, opt);
+}
+
+bool loadOBJ(const char* path, std::vector<VertexIn>& outVerts, std::vector<glm::ivec3>& outIdx, const OBJLoadOptions& opt) {
+    OBJMesh m; if (!loadOBJ(path, m, opt)) return false;
+    outVerts = std::move(m.verts); outIdx = std::move(m.idx); return true;
+}
+
 bool loadOBJ(const char* path,
     std::vector<VertexIn>& outVerts,
     std::vector<glm::ivec3>& outIdx,
     bool normalizeToUnit,
-    bool flipV) {
-    OBJMesh m; if (!loadOBJ(path, m, normalizeToUnit, flipV)) return false;
-    outVerts = std::move(m.verts); outIdx = std::move(m.idx); return true;
+    bool flipV,
+    bool mergeVertices) {
+    OBJLoadOptions opt; opt.normalizeToUnit = normalizeToUnit; opt.flipV = flipV; opt.mergeVertices = mergeVertices;
+    return loadOBJ(path, outVerts, outIdx, opt);
 }
@@ -1,4 +1,4 @@
-// أstb_image
+// 纹理加载（stb_image）
 #include "renderer/texture.hpp"
 #include <cstdio>
 